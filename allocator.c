@@ -0,0 +1,201 @@
+#include <string.h>
+
+#include "allocator.h"
+
+/* Every bump allocation is rounded up to this many bytes so that it is suitably aligned for any type */
+#define BUMP_ALIGN 16
+
+/* One block of a bump allocator; its allocations follow the header */
+typedef struct BumpBlock
+{
+    struct BumpBlock* next;     /* previously filled block */
+    size_t used, capacity;      /* bytes handed out from / available after the header */
+} BumpBlock;
+
+typedef struct BumpArena
+{
+    Allocator allocator;        /* must be first: the Allocator* handed out points here */
+    BumpBlock* blocks;          /* block currently being filled, then the older ones */
+    size_t blockSize;
+    size_t totalBytes;          /* bytes obtained from malloc, headers included */
+} BumpArena;
+
+void* bumpAlloc( void* arg, size_t size );
+void bumpRelease( void* arg, void* ptr, size_t size );
+
+/**********  Functions for tracked allocation **********/
+
+/* initMemTracker
+ * input: a pointer to a MemTracker, an Allocator (or NULL for malloc/free)
+ * output: none
+ *
+ * Sets up m to allocate through allocator with all of its counts at 0
+ */
+void initMemTracker( MemTracker* m, Allocator* allocator ){
+    m->allocator = allocator;
+    memset( &m->stats, 0, sizeof(MemStats) );
+}
+
+/* trackedAlloc
+ * input: a pointer to a MemTracker, a size
+ * output: a pointer to size bytes, or NULL if the allocator failed
+ *
+ * Allocates through m's allocator and adds size to its counts
+ */
+void* trackedAlloc( MemTracker* m, size_t size ){
+    void* ptr;
+
+    if( m->allocator!=NULL && m->allocator->alloc!=NULL )
+        ptr = m->allocator->alloc( m->allocator->arg, size );
+    else
+        ptr = malloc( size );
+    if( ptr==NULL )
+        return NULL;
+
+    m->stats.numAllocs++;
+    m->stats.currentBytes += size;
+    if( m->stats.currentBytes > m->stats.peakBytes )
+        m->stats.peakBytes = m->stats.currentBytes;
+    return ptr;
+}
+
+/* trackedRealloc
+ * input: a pointer to a MemTracker, a block from trackedAlloc with its size, and the new size
+ * output: a pointer to the resized block, or NULL if the allocator failed (ptr is then left untouched)
+ *
+ * Resizes ptr.  Allocators without a realloc get a new block that the contents are copied into.
+ */
+void* trackedRealloc( MemTracker* m, void* ptr, size_t oldSize, size_t newSize ){
+    void* grown;
+
+    if( m->allocator==NULL || m->allocator->alloc==NULL ){
+        grown = realloc( ptr, newSize );
+        if( grown==NULL )
+            return NULL;
+    }
+    else{
+        grown = m->allocator->alloc( m->allocator->arg, newSize );
+        if( grown==NULL )
+            return NULL;
+        memcpy( grown, ptr, oldSize < newSize ? oldSize : newSize );
+        if( m->allocator->release!=NULL )
+            m->allocator->release( m->allocator->arg, ptr, oldSize );
+    }
+
+    m->stats.numAllocs++;
+    m->stats.numFrees++;
+    m->stats.currentBytes += newSize - oldSize;
+    if( m->stats.currentBytes > m->stats.peakBytes )
+        m->stats.peakBytes = m->stats.currentBytes;
+    return grown;
+}
+
+/* trackedFree
+ * input: a pointer to a MemTracker, a block from trackedAlloc (or NULL) and its size
+ * output: none
+ *
+ * Returns ptr to m's allocator and subtracts size from its counts
+ */
+void trackedFree( MemTracker* m, void* ptr, size_t size ){
+    if( ptr==NULL )
+        return;
+    if( m->allocator==NULL || m->allocator->alloc==NULL )
+        free( ptr );
+    else if( m->allocator->release!=NULL )
+        m->allocator->release( m->allocator->arg, ptr, size );
+
+    m->stats.numFrees++;
+    m->stats.currentBytes -= size;
+}
+
+/* printMemStats
+ * input: a file, the name of a structure, its MemStats
+ * output: none
+ *
+ * Prints one line with the current and peak bytes and the allocation counts
+ */
+void printMemStats( FILE* out, const char* name, MemStats* s ){
+    fprintf( out, "Memory of %s: current %zu bytes, peak %zu bytes, %lu allocs, %lu frees\n",
+             name, s->currentBytes, s->peakBytes, s->numAllocs, s->numFrees );
+}
+
+
+/**********  Functions for bump allocators **********/
+
+/* createBumpAllocator
+ * input: the size of the blocks to take from malloc
+ * output: a pointer to an Allocator (free it with freeBumpAllocator), or NULL if malloc failed
+ *
+ * Creates an allocator that hands out consecutive pieces of large blocks and ignores frees; all of its memory is
+ * returned at once by freeBumpAllocator.  It suits structures that are built, used and then thrown away whole.
+ * It has no lock, so it must only be used by one thread at a time.
+ */
+Allocator* createBumpAllocator( size_t blockSize ){
+    BumpArena* arena = (BumpArena*)malloc( sizeof(BumpArena) );
+    if( arena==NULL )
+        return NULL;
+    arena->allocator.alloc = bumpAlloc;
+    arena->allocator.release = bumpRelease;
+    arena->allocator.arg = arena;
+    arena->blocks = NULL;
+    arena->blockSize = blockSize;
+    arena->totalBytes = 0;
+    return &arena->allocator;
+}
+
+/* freeBumpAllocator
+ * input: an Allocator from createBumpAllocator
+ * output: none
+ *
+ * frees every block of the allocator.  Nothing allocated from it may be used afterwards.
+ */
+void freeBumpAllocator( Allocator* a ){
+    BumpArena* arena = (BumpArena*)a->arg;
+    BumpBlock* next;
+
+    while( arena->blocks!=NULL ){
+        next = arena->blocks->next;
+        free( arena->blocks );
+        arena->blocks = next;
+    }
+    free( arena );
+}
+
+/* getBumpAllocatorSize
+ * input: an Allocator from createBumpAllocator
+ * output: a size
+ *
+ * Returns the number of bytes the allocator has taken from malloc
+ */
+size_t getBumpAllocatorSize( Allocator* a ){
+    return ((BumpArena*)a->arg)->totalBytes;
+}
+
+void* bumpAlloc( void* arg, size_t size ){
+    BumpArena* arena = (BumpArena*)arg;
+    BumpBlock* block = arena->blocks;
+    size_t capacity;
+    void* ptr;
+
+    size = (size + BUMP_ALIGN-1) & ~(size_t)(BUMP_ALIGN-1);
+    if( block==NULL || block->capacity - block->used < size ){
+        capacity = size > arena->blockSize ? size : arena->blockSize;
+        block = (BumpBlock*)malloc( sizeof(BumpBlock) + BUMP_ALIGN + capacity );
+        if( block==NULL )
+            return NULL;
+        block->next = arena->blocks;
+        block->used = 0;
+        block->capacity = capacity;
+        arena->blocks = block;
+        arena->totalBytes += sizeof(BumpBlock) + BUMP_ALIGN + capacity;
+    }
+
+    /* the allocations start at the first aligned address after the header */
+    ptr = (char*)( ( (size_t)(block + 1) + BUMP_ALIGN-1 ) & ~(size_t)(BUMP_ALIGN-1) ) + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void bumpRelease( void* arg, void* ptr, size_t size ){
+    /* memory is only returned by freeBumpAllocator */
+}
@@ -0,0 +1,46 @@
+#ifndef _allocator_h
+#define _allocator_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Caller-provided allocator.  release is given the size that was allocated, so arena and bump allocators
+ * need no per-block header.  A NULL Allocator* (or NULL function) means malloc/free.  A structure calls its
+ * Allocator under the same locking as the rest of its updates, so an Allocator shared by several structures that
+ * are changed concurrently must do its own locking. */
+typedef struct Allocator
+{
+    void* (*alloc)( void* arg, size_t size );               /* returns NULL on failure */
+    void (*release)( void* arg, void* ptr, size_t size );   /* may do nothing */
+    void* arg;
+} Allocator;
+
+/* Memory accounting of one structure instance */
+typedef struct MemStats
+{
+    size_t currentBytes;        /* bytes allocated and not yet freed */
+    size_t peakBytes;           /* largest value currentBytes has had */
+    unsigned long numAllocs;    /* number of allocations (a resize counts as one) */
+    unsigned long numFrees;     /* number of frees */
+} MemStats;
+
+/* Embedded in every structure that allocates through an Allocator */
+typedef struct MemTracker
+{
+    Allocator* allocator;       /* NULL for malloc/free */
+    MemStats stats;
+} MemTracker;
+
+/**********  Functions for tracked allocation **********/
+void initMemTracker( MemTracker* m, Allocator* allocator );
+void* trackedAlloc( MemTracker* m, size_t size );
+void* trackedRealloc( MemTracker* m, void* ptr, size_t oldSize, size_t newSize );
+void trackedFree( MemTracker* m, void* ptr, size_t size );
+void printMemStats( FILE* out, const char* name, MemStats* s );
+
+/**********  Functions for bump allocators **********/
+Allocator* createBumpAllocator( size_t blockSize );
+void freeBumpAllocator( Allocator* a );
+size_t getBumpAllocatorSize( Allocator* a );
+
+#endif
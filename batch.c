@@ -0,0 +1,433 @@
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "loader.h"
+#include "radixSort.h"
+#include "instrument.h"
+
+/* Double-ended queue of file indices owned by one worker.  The owner takes work from the tail and idle
+ * workers steal from the head, so the two ends are only contended when a deque is almost empty. */
+typedef struct BatchDeque
+{
+    pthread_mutex_t lock;       /* protects head and tail */
+    int *files;                 /* indices into the batch's file names */
+    int head, tail;             /* the deque holds files[head..tail-1] */
+} __attribute__((aligned(64))) BatchDeque;
+
+/* State shared by all workers of one batch */
+typedef struct BatchShared
+{
+    char **fileNames;
+    BatchResult *results;
+    BatchDeque *deques;
+    int numWorkers;
+    int threadsPerFile;         /* threads one file may load and solve with, 1 whenever files run side by side */
+    ctpEngine engine;
+} BatchShared;
+
+/* Argument of one worker thread */
+typedef struct BatchWorker
+{
+    BatchShared *sh;
+    int id;                     /* index of the worker's own deque */
+} BatchWorker;
+
+void *batchWorker( void *arg );
+bool popBatchDeque( BatchDeque* dq, int* file );
+bool stealBatchDeque( BatchDeque* dq, int* file );
+void evaluateBatchFile( BatchShared* sh, int file );
+int compareFileNames( const void* a, const void* b );
+bool addBatchFile( char*** pfileNames, int* pnumFiles, int* pcapacity, const char* dir, const char* name );
+void writeCSVString( FILE* out, const char* s );
+void writeJSONString( FILE* out, const char* s );
+
+/**********  Functions for evaluating many CTP files **********/
+
+/* collectBatchFiles
+ * input: a directory or list file name, and pointers to store the file names and their count in
+ * output: a boolean
+ *
+ * If path is a directory, collects every regular file in it (skipping hidden ones) sorted by name.
+ * Otherwise path is read as a list of file names, one per line; blank lines are skipped.
+ * Returns FALSE (after printing why to stderr) if the path cannot be read; nothing is left allocated then.
+ */
+bool collectBatchFiles( char* path, char*** pfileNames, int* pnumFiles ){
+    struct stat sb;
+    DIR* dir;
+    struct dirent* entry;
+    FILE* list;
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t len;
+    int capacity = 0;
+    bool ok = true;
+
+    *pfileNames = NULL;
+    *pnumFiles = 0;
+
+    if( stat( path, &sb ) != 0 ){
+        fprintf( stderr, "File %s not found.\n", path );
+        return false;
+    }
+
+    if( S_ISDIR( sb.st_mode ) ){
+        dir = opendir( path );
+        if( dir == NULL ){
+            fprintf( stderr, "Cannot open directory %s.\n", path );
+            return false;
+        }
+        while( ok && ( entry = readdir( dir ) ) != NULL ){
+            if( entry->d_name[0] != '.' )
+                ok = addBatchFile( pfileNames, pnumFiles, &capacity, path, entry->d_name );
+        }
+        closedir( dir );
+        if( ok )
+            qsort( *pfileNames, *pnumFiles, sizeof(char*), compareFileNames );
+    }
+    else{
+        list = fopen( path, "r" );
+        if( list == NULL ){
+            fprintf( stderr, "File %s not found.\n", path );
+            return false;
+        }
+        while( ok && ( len = getline( &line, &lineCapacity, list ) ) >= 0 ){
+            while( len > 0 && ( line[len-1] == '\n' || line[len-1] == '\r' ) )
+                line[--len] = '\0';
+            if( len > 0 )
+                ok = addBatchFile( pfileNames, pnumFiles, &capacity, NULL, line );
+        }
+        free( line );
+        fclose( list );
+    }
+
+    if( !ok ){
+        fprintf( stderr, "malloc failed\n" );
+        freeBatchFiles( *pfileNames, *pnumFiles );
+        *pfileNames = NULL;
+        *pnumFiles = 0;
+    }
+    return ok;
+}
+
+/* addBatchFile
+ * input: the growing array of file names, its length and capacity, a directory (or NULL) and a file name
+ * output: a boolean
+ *
+ * Appends dir/name to the file names.  Directory entries that are not regular files are skipped.
+ * Returns FALSE if memory runs out.
+ */
+bool addBatchFile( char*** pfileNames, int* pnumFiles, int* pcapacity, const char* dir, const char* name ){
+    struct stat sb;
+    char** grown;
+    char* fileName;
+    size_t length = strlen( name ) + ( dir != NULL ? strlen( dir ) + 1 : 0 );
+
+    fileName = (char*)malloc( length+1 );
+    if( fileName == NULL )
+        return false;
+    if( dir != NULL )
+        sprintf( fileName, "%s/%s", dir, name );
+    else
+        strcpy( fileName, name );
+
+    if( dir != NULL && ( stat( fileName, &sb ) != 0 || !S_ISREG( sb.st_mode ) ) ){
+        free( fileName );
+        return true;
+    }
+
+    if( *pnumFiles == *pcapacity ){
+        grown = (char**)realloc( *pfileNames, ( *pcapacity > 0 ? 2*(*pcapacity) : 64 )*sizeof(char*) );
+        if( grown == NULL ){
+            free( fileName );
+            return false;
+        }
+        *pfileNames = grown;
+        *pcapacity = *pcapacity > 0 ? 2*(*pcapacity) : 64;
+    }
+    (*pfileNames)[(*pnumFiles)++] = fileName;
+    return true;
+}
+
+/* freeBatchFiles
+ * input: an array of file names from collectBatchFiles and its length
+ * output: none
+ *
+ * frees the file names and the array holding them
+ */
+void freeBatchFiles( char** fileNames, int numFiles ){
+    int i;
+    for( i=0; i<numFiles; i++ )
+        free( fileNames[i] );
+    free( fileNames );
+}
+
+/* runBatch
+ * input: an array of file names and its length, a thread count, the engine to solve with, and an array to store
+ *        one result per file in
+ * output: a boolean
+ *
+ * Loads and solves every file on a small work-stealing pool.  The files are dealt round-robin into one deque per
+ * worker; a worker takes its own files from the tail of its deque and, once that is empty, steals from the head
+ * of the others, so a few huge routes cannot leave the rest of the pool idle.  The calling thread is worker 0,
+ * and a worker thread that fails to start simply has its files stolen, so the batch always completes.  With more
+ * than one worker each file is loaded and solved serially, so the pool is not oversubscribed by nested threads.
+ * A file that cannot be loaded or solved only marks its own result as failed.
+ * Returns FALSE (without evaluating anything) only if the pool itself cannot be allocated.
+ */
+bool runBatch( char** fileNames, int numFiles, int numThreads, ctpEngine engine, BatchResult* results ){
+    BatchShared sh;
+    BatchWorker *workers;
+    pthread_t *threads;
+    bool *started;
+    int i, t;
+
+    if( numThreads > numFiles )
+        numThreads = numFiles;
+    if( numThreads < 1 )
+        numThreads = 1;
+
+    sh.fileNames = fileNames;
+    sh.results = results;
+    sh.numWorkers = numThreads;
+    sh.threadsPerFile = numThreads > 1 ? 1 : getNumCPUs( );
+    sh.engine = engine;
+    sh.deques = (BatchDeque*)aligned_alloc( 64, numThreads*sizeof(BatchDeque) );
+    workers = (BatchWorker*)malloc( numThreads*sizeof(BatchWorker) );
+    threads = (pthread_t*)malloc( numThreads*sizeof(pthread_t) );
+    started = (bool*)calloc( numThreads, sizeof(bool) );
+    if( sh.deques != NULL ){
+        for( t=0; t<numThreads; t++ )
+            sh.deques[t].files = (int*)malloc( ( numFiles/numThreads + 1 )*sizeof(int) );
+        for( t=0; t<numThreads && sh.deques[t].files != NULL; t++ )
+            ;
+    }
+    if( sh.deques == NULL || t < numThreads || workers == NULL || threads == NULL || started == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        for( t=0; sh.deques != NULL && t<numThreads; t++ )
+            free( sh.deques[t].files );
+        free( sh.deques );
+        free( workers );
+        free( threads );
+        free( started );
+        return false;
+    }
+
+    for( t=0; t<numThreads; t++ ){
+        pthread_mutex_init( &sh.deques[t].lock, NULL );
+        sh.deques[t].head = 0;
+        sh.deques[t].tail = 0;
+        workers[t].sh = &sh;
+        workers[t].id = t;
+    }
+    for( i=0; i<numFiles; i++ ){
+        BatchDeque *dq = &sh.deques[i % numThreads];
+        dq->files[dq->tail++] = i;
+    }
+
+    for( t=1; t<numThreads; t++ )
+        started[t] = pthread_create( &threads[t], NULL, batchWorker, &workers[t] ) == 0;
+    batchWorker( &workers[0] );
+    for( t=1; t<numThreads; t++ ){
+        if( started[t] )
+            pthread_join( threads[t], NULL );
+    }
+
+    for( t=0; t<numThreads; t++ ){
+        pthread_mutex_destroy( &sh.deques[t].lock );
+        free( sh.deques[t].files );
+    }
+    free( sh.deques );
+    free( workers );
+    free( threads );
+    free( started );
+    return true;
+}
+
+/* batchWorker
+ * input: a pointer to a BatchWorker
+ * output: NULL
+ *
+ * Evaluates files from the worker's own deque, then steals from the other deques until every deque is empty.
+ * No files are added once the batch starts, so a full pass over empty deques means the batch is done.
+ */
+void *batchWorker( void *arg ){
+    BatchWorker *w = (BatchWorker*)arg;
+    BatchShared *sh = w->sh;
+    int file, t;
+    bool found = true;
+
+    while( found ){
+        while( popBatchDeque( &sh->deques[w->id], &file ) )
+            evaluateBatchFile( sh, file );
+
+        found = false;
+        for( t=1; t<sh->numWorkers && !found; t++ )
+            found = stealBatchDeque( &sh->deques[(w->id + t) % sh->numWorkers], &file );
+        if( found )
+            evaluateBatchFile( sh, file );
+    }
+    FLUSH_COUNTERS( );
+    return NULL;
+}
+
+/* popBatchDeque and stealBatchDeque
+ * input: a BatchDeque and a pointer to store a file index in
+ * output: a boolean
+ *
+ * Removes a file from the tail (owner) / head (thief) of the deque, returning FALSE if it is empty
+ */
+bool popBatchDeque( BatchDeque* dq, int* file ){
+    bool found = false;
+    pthread_mutex_lock( &dq->lock );
+    if( dq->head < dq->tail ){
+        *file = dq->files[--dq->tail];
+        found = true;
+    }
+    pthread_mutex_unlock( &dq->lock );
+    return found;
+}
+
+bool stealBatchDeque( BatchDeque* dq, int* file ){
+    bool found = false;
+    pthread_mutex_lock( &dq->lock );
+    if( dq->head < dq->tail ){
+        *file = dq->files[dq->head++];
+        found = true;
+    }
+    pthread_mutex_unlock( &dq->lock );
+    return found;
+}
+
+/* evaluateBatchFile
+ * input: the shared batch state and a file index
+ * output: none
+ *
+ * Loads and solves one file, recording its answer, status and timings in its result
+ */
+void evaluateBatchFile( BatchShared* sh, int file ){
+    BatchResult *r = &sh->results[file];
+    double *moveSequence;
+    double start = getWallTime( );
+
+    r->fileName = sh->fileNames[file];
+    r->numMoves = 0;
+    r->providedSolution = -1;
+    r->computedSolution = -1;
+    r->solveSeconds = 0;
+
+    if( !loadMoves( r->fileName, &moveSequence, &r->providedSolution, &r->numMoves, sh->threadsPerFile ) ){
+        r->loadSeconds = getWallTime( ) - start;
+        r->status = BATCH_LOAD_FAILED;
+        return;
+    }
+    r->loadSeconds = getWallTime( ) - start;
+
+    start = getWallTime( );
+    r->computedSolution = carTraversal( moveSequence, r->numMoves, sh->engine, sh->threadsPerFile );
+    r->solveSeconds = getWallTime( ) - start;
+
+    if( r->computedSolution < 0 )
+        r->status = BATCH_SOLVE_FAILED;
+    else if( r->providedSolution == -1 )
+        r->status = BATCH_UNCHECKED;
+    else if( r->computedSolution == r->providedSolution )
+        r->status = BATCH_OK;
+    else
+        r->status = BATCH_MISMATCH;
+}
+
+/* getBatchStatusName
+ * input: a batchStatus
+ * output: a string
+ *
+ * Returns the name used for the status in batch summaries
+ */
+const char* getBatchStatusName( batchStatus status ){
+    if( status == BATCH_OK )
+        return "ok";
+    if( status == BATCH_MISMATCH )
+        return "mismatch";
+    if( status == BATCH_UNCHECKED )
+        return "unchecked";
+    if( status == BATCH_LOAD_FAILED )
+        return "load-failed";
+    return "solve-failed";
+}
+
+int compareFileNames( const void* a, const void* b ){
+    return strcmp( *(char* const*)a, *(char* const*)b );
+}
+
+
+/**********  Functions for writing batch summaries **********/
+
+/* writeBatchCSV
+ * input: an output file, an array of batch results and its length
+ * output: none
+ *
+ * Writes one CSV row per file after a header row
+ */
+void writeBatchCSV( FILE* out, BatchResult* results, int numFiles ){
+    int i;
+    fprintf( out, "file,status,moves,provided,computed,load_seconds,solve_seconds\n" );
+    for( i=0; i<numFiles; i++ ){
+        writeCSVString( out, results[i].fileName );
+        fprintf( out, ",%s,%d,%d,%d,%.6f,%.6f\n", getBatchStatusName( results[i].status ), results[i].numMoves,
+                 results[i].providedSolution, results[i].computedSolution, results[i].loadSeconds, results[i].solveSeconds );
+    }
+}
+
+/* writeBatchJSON
+ * input: an output file, an array of batch results and its length
+ * output: none
+ *
+ * Writes the results as a JSON array holding one object per file
+ */
+void writeBatchJSON( FILE* out, BatchResult* results, int numFiles ){
+    int i;
+    fprintf( out, "[\n" );
+    for( i=0; i<numFiles; i++ ){
+        fprintf( out, "  {\"file\": " );
+        writeJSONString( out, results[i].fileName );
+        fprintf( out, ", \"status\": \"%s\", \"moves\": %d, \"provided\": %d, \"computed\": %d, \"load_seconds\": %.6f, \"solve_seconds\": %.6f}%s\n",
+                 getBatchStatusName( results[i].status ), results[i].numMoves, results[i].providedSolution,
+                 results[i].computedSolution, results[i].loadSeconds, results[i].solveSeconds, i+1 < numFiles ? "," : "" );
+    }
+    fprintf( out, "]\n" );
+}
+
+/* writeCSVString and writeJSONString
+ * input: an output file and a string
+ * output: none
+ *
+ * Writes the string as a CSV field (quoted only if needed) / as a JSON string literal
+ */
+void writeCSVString( FILE* out, const char* s ){
+    if( strpbrk( s, ",\"\r\n" ) == NULL ){
+        fputs( s, out );
+        return;
+    }
+    fputc( '"', out );
+    for( ; *s; s++ ){
+        if( *s == '"' )
+            fputc( '"', out );
+        fputc( *s, out );
+    }
+    fputc( '"', out );
+}
+
+void writeJSONString( FILE* out, const char* s ){
+    fputc( '"', out );
+    for( ; *s; s++ ){
+        if( *s == '"' || *s == '\\' )
+            fprintf( out, "\\%c", *s );
+        else if( (unsigned char)*s < 0x20 )
+            fprintf( out, "\\u%04x", (unsigned char)*s );
+        else
+            fputc( *s, out );
+    }
+    fputc( '"', out );
+}
@@ -0,0 +1,34 @@
+#ifndef _batch_h
+#define _batch_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "ctp.h"
+
+/* Outcome of evaluating one CTP file */
+typedef enum batchStatus{ BATCH_OK, BATCH_MISMATCH, BATCH_UNCHECKED, BATCH_LOAD_FAILED, BATCH_SOLVE_FAILED } batchStatus;
+
+/* Result and timing of one file of a batch */
+typedef struct BatchResult
+{
+    char *fileName;             /* file that was evaluated (not owned) */
+    batchStatus status;
+    int numMoves;
+    int providedSolution;       /* -1 if the file provides none */
+    int computedSolution;       /* -1 if the file could not be solved */
+    double loadSeconds;
+    double solveSeconds;
+} BatchResult;
+
+/**********  Functions for evaluating many CTP files **********/
+bool collectBatchFiles( char* path, char*** pfileNames, int* pnumFiles );
+void freeBatchFiles( char** fileNames, int numFiles );
+bool runBatch( char** fileNames, int numFiles, int numThreads, ctpEngine engine, BatchResult* results );
+const char* getBatchStatusName( batchStatus status );
+
+/**********  Functions for writing batch summaries **********/
+void writeBatchCSV( FILE* out, BatchResult* results, int numFiles );
+void writeBatchJSON( FILE* out, BatchResult* results, int numFiles );
+
+#endif
@@ -0,0 +1,1670 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <math.h>
+#include <limits.h>
+
+#include "tree.h"
+#include "priorityQueue.h"
+#include "huffman.h"
+#include "radixSort.h"
+#include "multiQueue.h"
+#include "shardedMap.h"
+#include "optimisticTree.h"
+#include "persistentTree.h"
+#include "instrument.h"
+
+#define PREFILL_SIZE 65536
+#define MAP_BATCH_SIZE 64
+#define SUITE_BLOCKS 100            /* timed blocks each suite phase is split into */
+#define SUITE_HUFFMAN_CHUNK 4096    /* characters per Huffman tree built by the suite */
+#define SUITE_ZIPF_EXPONENT 0.99
+#define HUFFMAN_BENCH_BUILDS 100    /* trees and code tables built per repetition of the Huffman benchmark */
+
+/**********  Functions for benchmarking priority queues **********/
+typedef struct PQBenchArgs
+{
+    bool relaxed;               /* true to use the MultiQueue, false for the globally locked PriorityQueue */
+    PriorityQueue *ppq;
+    pthread_mutex_t *lock;
+    MultiQueue *pmq;
+    TNode *nodes;               /* elements this thread inserts */
+    int numOps;                 /* number of insert/remove pairs */
+} PQBenchArgs;
+
+void benchPriorityQueues( int maxThreads, int numOps );
+double runPQBench( bool relaxed, int numThreads, int numOps );
+void *pqBenchWorker( void *arg );
+
+/**********  Functions for benchmarking segment trees **********/
+void benchSegmentInsert( int maxThreads, int numSegments, int numPoints );
+
+/**********  Functions for benchmarking AVL searches **********/
+void benchTreeSearch( int maxKeys, int numLookups, int batchSize );
+
+/**********  Functions for benchmarking tree layouts **********/
+void benchTreeLayout( long maxKeys, int numLookups );
+
+/**********  Functions for benchmarking allocators **********/
+void benchMemory( int numKeys );
+void printMemoryRow( const char *structure, const char *allocatorName, Allocator *allocator, double seconds, MemStats *mem );
+
+/**********  Functions for benchmarking Huffman compression **********/
+typedef enum corpusType{ CORPUS_UNIFORM, CORPUS_ZIPF, CORPUS_ENGLISH, CORPUS_SINGLE, NUM_CORPORA } corpusType;
+
+typedef struct HuffmanBenchConfig
+{
+    long size;                  /* characters per corpus */
+    int corpus;                 /* corpusType to run, or NUM_CORPORA for all of them */
+    double zipfExponent;        /* skew of CORPUS_ZIPF */
+    double dominant;            /* share of the most common character in CORPUS_SINGLE */
+    int reps;                   /* repetitions of every measurement */
+} HuffmanBenchConfig;
+
+void runHuffmanBench( int argc, char *argv[] );
+void benchHuffmanCorpus( HuffmanBenchConfig *cfg, corpusType corpus, char *text, unsigned char *encoded, char *decoded );
+void createCorpus( HuffmanBenchConfig *cfg, corpusType corpus, char *text );
+double getEntropy( int charCounts[HUFFMAN_ALPHABET], long total );
+double getMedian( double *values, int n );
+const char *getCorpusName( corpusType corpus );
+
+/**********  Functions for benchmarking sharded maps **********/
+typedef enum mapBenchMode{ MAP_BENCH_SINGLE, MAP_BENCH_BATCHED, MAP_BENCH_OPTIMISTIC } mapBenchMode;
+
+typedef struct MapBenchArgs
+{
+    mapBenchMode mode;
+    ShardedMap *map;
+    OptimisticTree *ot;         /* used instead of map by MAP_BENCH_OPTIMISTIC */
+    char **keys;                /* key space shared by all threads */
+    int numKeys;                /* length of keys */
+    int readPercent;            /* share of operations that are searches */
+    int numOps;                 /* number of operations */
+    unsigned int seed;
+} MapBenchArgs;
+
+void benchShardedMap( int maxThreads, int numShards, int numKeys, int numOps );
+void benchOptimisticTree( int maxThreads, int numKeys, int numOps );
+char **createBenchKeys( int numKeys );
+double runMapBench( mapBenchMode mode, int numShards, int readPercent, int numThreads, char **keys, int numKeys, int numOps );
+void *mapBenchWorker( void *arg );
+void fillMapOp( MapBenchArgs *a, MapOp *op );
+Data *createBenchData( char *key );
+
+/**********  Functions for benchmarking persistent trees **********/
+typedef struct PTBenchArgs
+{
+    PersistentTree *pt;
+    char **keys;
+    int numKeys;
+    int numOps;                 /* updates made by the writer */
+    bool done;                  /* set by the writer when it is finished */
+    long numSnapshots;          /* snapshots checked by the reader */
+    long numErrors;             /* snapshots that were not a consistent version */
+} PTBenchArgs;
+
+/* What the reader has seen while scanning one snapshot */
+typedef struct PTScanState
+{
+    char *last;                 /* previous key visited */
+    int count;
+    bool sorted;
+} PTScanState;
+
+void benchPersistentTree( int numKeys, int numOps );
+void *ptWriterWorker( void *arg );
+void *ptReaderWorker( void *arg );
+void checkSnapshotKey( Data *d, void *arg );
+
+/**********  Functions for the benchmark suite **********/
+typedef enum keyDist{ DIST_SEQUENTIAL, DIST_RANDOM, DIST_ZIPF } keyDist;
+
+typedef enum suitePhase{ PHASE_AVL_INSERT, PHASE_AVL_SEARCH, PHASE_AVL_REMOVE, PHASE_PQ_INSERT, PHASE_PQ_REMOVE,
+                         PHASE_HUFFMAN_BUILD, PHASE_HUFFMAN_ENCODE, PHASE_SEGMENT_BUILD, PHASE_SEGMENT_QUERY,
+                         NUM_PHASES } suitePhase;
+
+typedef struct SuiteConfig
+{
+    int size;                   /* keys, queue elements, characters and segments per repetition */
+    keyDist dist;               /* distribution of keys, priorities, characters and coordinates */
+    int numThreads;             /* threads running the suite side by side, each on its own structures */
+    int reps;                   /* repetitions of every phase */
+    char *jsonFile;             /* where to write the JSON report (NULL for none) */
+} SuiteConfig;
+
+/* Structures and inputs of one suite thread */
+typedef struct SuiteState
+{
+    SuiteConfig *cfg;
+    char **keys;                /* key strings shared by all threads */
+    double *zipfKeys;           /* cumulative Zipf distribution over cfg->size ranks */
+    double *zipfChars;          /* cumulative Zipf distribution over the alphabet */
+    unsigned long long seed;
+    long checksum;              /* keeps the compiler from dropping results */
+
+    int *order;                 /* order keys are inserted and removed in */
+    Data **inserts;
+    Data *queries;
+    Data **removed;
+    Tree *tree;
+
+    TNode *pqNodes;
+    PriorityQueue *ppq;
+
+    char *text;
+    unsigned int codes[HUFFMAN_ALPHABET];
+    int lengths[HUFFMAN_ALPHABET];
+    unsigned char *encoded;
+
+    double *positions;          /* segment i runs from positions[2i] to positions[2i+1] */
+    double *points;
+    int *segmentStarts, *segmentEnds, *queryRanks;
+    int numPoints;
+    SegmentTree *st;
+
+    /* filled in while running */
+    double *phaseStart, *phaseEnd;  /* [phase][rep] */
+    double *samples;                /* nanoseconds per operation of each block, [phase][rep][block] */
+    pthread_barrier_t *barrier;
+} SuiteState;
+
+void runSuite( int argc, char *argv[] );
+void *suiteWorker( void *arg );
+void prepareSuiteRep( SuiteState *s );
+void finishSuiteRep( SuiteState *s );
+long getSuiteOps( SuiteConfig *cfg, suitePhase phase );
+void runSuitePhase( SuiteState *s, suitePhase phase, long begin, long end );
+void reportSuite( SuiteConfig *cfg, SuiteState *states );
+const char *getPhaseName( suitePhase phase );
+const char *getDistName( keyDist dist );
+double *createZipfTable( int n );
+int sampleDist( SuiteState *s, keyDist dist, double *zipf, int n, long i );
+unsigned long long nextSuiteRandom( SuiteState *s );
+int compareSamples( const void *a, const void *b );
+
+int main( int argc, char *argv[] )
+{
+    if( argc >= 2 && strcmp( argv[1], "suite" )==0 ){
+        runSuite( argc-1, argv+1 );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "huffman" )==0 ){
+        runHuffmanBench( argc-1, argv+1 );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "multiqueue" )==0 ){
+        int maxThreads = argc>=3 ? atoi( argv[2] ) : 8;
+        int numOps = argc>=4 ? atoi( argv[3] ) : 1000000;
+        benchPriorityQueues( maxThreads, numOps );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "segment-insert" )==0 ){
+        int maxThreads = argc>=3 ? atoi( argv[2] ) : 8;
+        int numSegments = argc>=4 ? atoi( argv[3] ) : 100000000;
+        int numPoints = argc>=5 ? atoi( argv[4] ) : 1000000;
+        benchSegmentInsert( maxThreads, numSegments, numPoints );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "tree-search" )==0 ){
+        int maxKeys = argc>=3 ? atoi( argv[2] ) : 1<<21;
+        int numLookups = argc>=4 ? atoi( argv[3] ) : 1000000;
+        int batchSize = argc>=5 ? atoi( argv[4] ) : 32;
+        benchTreeSearch( maxKeys, numLookups, batchSize > 0 ? batchSize : 1 );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "tree-layout" )==0 ){
+        long maxKeys = argc>=3 ? atol( argv[2] ) : 100000000;
+        int numLookups = argc>=4 ? atoi( argv[3] ) : 10000000;
+        benchTreeLayout( maxKeys > 0 ? maxKeys : 1, numLookups > 0 ? numLookups : 1 );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "memory" )==0 ){
+        int numKeys = argc>=3 ? atoi( argv[2] ) : 1000000;
+        benchMemory( numKeys > 0 ? numKeys : 1 );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "sharded-map" )==0 ){
+        int maxThreads = argc>=3 ? atoi( argv[2] ) : 8;
+        int numShards = argc>=4 ? atoi( argv[3] ) : 64;
+        int numKeys = argc>=5 ? atoi( argv[4] ) : 1000000;
+        int numOps = argc>=6 ? atoi( argv[5] ) : 1000000;
+        benchShardedMap( maxThreads, numShards, numKeys, numOps );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "optimistic" )==0 ){
+        int maxThreads = argc>=3 ? atoi( argv[2] ) : 8;
+        int numKeys = argc>=4 ? atoi( argv[3] ) : 1000000;
+        int numOps = argc>=5 ? atoi( argv[4] ) : 1000000;
+        benchOptimisticTree( maxThreads, numKeys, numOps );
+        return 0;
+    }
+
+    if( argc >= 2 && strcmp( argv[1], "persistent" )==0 ){
+        int numKeys = argc>=3 ? atoi( argv[2] ) : 1000000;
+        int numOps = argc>=4 ? atoi( argv[3] ) : 1000000;
+        benchPersistentTree( numKeys > 0 ? numKeys : 1, numOps );
+        return 0;
+    }
+
+    printf( "usage: %s suite [--size N] [--dist sequential|random|zipf] [--threads T] [--reps R] [--json FILE]\n", argv[0] );
+    printf( "       %s huffman [--size N] [--corpus uniform|zipf|english|single|all] [--zipf S] [--dominant P] [--reps R]\n", argv[0] );
+    printf( "       %s multiqueue [maxThreads] [opsPerThread]\n", argv[0] );
+    printf( "       %s segment-insert [maxThreads] [numSegments] [numPoints]\n", argv[0] );
+    printf( "       %s tree-search [maxKeys] [numLookups] [batchSize]\n", argv[0] );
+    printf( "       %s tree-layout [maxKeys] [numLookups]\n", argv[0] );
+    printf( "       %s memory [numKeys]\n", argv[0] );
+    printf( "       %s sharded-map [maxThreads] [numShards] [numKeys] [opsPerThread]\n", argv[0] );
+    printf( "       %s optimistic [maxThreads] [numKeys] [opsPerThread]\n", argv[0] );
+    printf( "       %s persistent [numKeys] [numOps]\n", argv[0] );
+    return 1;
+}
+
+
+/**********  Functions for benchmarking priority queues **********/
+
+/* benchPriorityQueues
+ * input: the largest thread count to run and the number of insert/remove pairs per thread
+ * output: none
+ *
+ * Prints the throughput of a mutex-protected PriorityQueue and of a MultiQueue for 1 to maxThreads threads
+ */
+void benchPriorityQueues( int maxThreads, int numOps ){
+    int t;
+    printf( "threads,locked_pq_mops,multiqueue_mops\n" );
+    for( t=1; t<=maxThreads; t = t<maxThreads && t*2>maxThreads ? maxThreads : t*2 ){
+        double locked = runPQBench( false, t, numOps );
+        double relaxed = runPQBench( true, t, numOps );
+        printf( "%d,%.3lf,%.3lf\n", t, locked, relaxed );
+    }
+}
+
+/* runPQBench
+ * input: which queue to use, the number of threads, and the number of insert/remove pairs per thread
+ * output: a double
+ *
+ * Runs numThreads workers against a shared queue and returns the throughput in millions of operations per second
+ */
+double runPQBench( bool relaxed, int numThreads, int numOps ){
+    int i, j;
+    double start, end;
+    pthread_t *threads = (pthread_t *)malloc( numThreads*sizeof(pthread_t) );
+    PQBenchArgs *args = (PQBenchArgs *)malloc( numThreads*sizeof(PQBenchArgs) );
+    TNode *prefill = (TNode *)malloc( PREFILL_SIZE*sizeof(TNode) );
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    PriorityQueue *ppq = createPQ( );
+    MultiQueue *pmq = createMQ( 2*numThreads );
+
+    srand( 1 );
+    for( i=0; i<PREFILL_SIZE; i++ ){
+        prefill[i].priority = rand( );
+        if( relaxed )
+            insertMQ( pmq, &prefill[i] );
+        else
+            insertPQ( ppq, &prefill[i] );
+    }
+
+    for( i=0; i<numThreads; i++ ){
+        args[i].relaxed = relaxed;
+        args[i].ppq = ppq;
+        args[i].lock = &lock;
+        args[i].pmq = pmq;
+        args[i].numOps = numOps;
+        args[i].nodes = (TNode *)malloc( numOps*sizeof(TNode) );
+        for( j=0; j<numOps; j++ )
+            args[i].nodes[j].priority = rand( );
+    }
+
+    start = getWallTime( );
+    for( i=0; i<numThreads; i++ )
+        pthread_create( &threads[i], NULL, pqBenchWorker, &args[i] );
+    for( i=0; i<numThreads; i++ )
+        pthread_join( threads[i], NULL );
+    end = getWallTime( );
+
+    for( i=0; i<numThreads; i++ )
+        free( args[i].nodes );
+    freeMQ( pmq );
+    freePQ( ppq );
+    free( prefill );
+    free( args );
+    free( threads );
+
+    return 2.0*numOps*numThreads / (end - start) / 1e6;
+}
+
+/* pqBenchWorker
+ * input: a pointer to a PQBenchArgs
+ * output: NULL
+ *
+ * Alternates inserting one of its own nodes and removing the front of the shared queue
+ */
+void *pqBenchWorker( void *arg ){
+    PQBenchArgs *a = (PQBenchArgs *)arg;
+    int i;
+
+    for( i=0; i<a->numOps; i++ ){
+        if( a->relaxed ){
+            insertMQ( a->pmq, &a->nodes[i] );
+            removeMQ( a->pmq );
+        }
+        else{
+            pthread_mutex_lock( a->lock );
+            insertPQ( a->ppq, &a->nodes[i] );
+            removePQ( a->ppq );
+            pthread_mutex_unlock( a->lock );
+        }
+    }
+    return NULL;
+}
+
+
+/**********  Functions for benchmarking segment trees **********/
+
+/* benchSegmentInsert
+ * input: the largest thread count to run, the number of segments and the number of points in the tree
+ * output: none
+ *
+ * Prints the time insertSegmentsST takes to insert numSegments random segments with 1 to maxThreads threads
+ */
+void benchSegmentInsert( int maxThreads, int numSegments, int numPoints ){
+    int i, t, a, b;
+    double start, end, base = 0;
+    double *points = (double *)malloc( numPoints*sizeof(double) );
+    int *segmentStarts = (int *)malloc( numSegments*sizeof(int) );
+    int *segmentEnds = (int *)malloc( numSegments*sizeof(int) );
+    SegmentTree *st;
+
+    if( points==NULL || segmentStarts==NULL || segmentEnds==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    for( i=0; i<numPoints; i++ )
+        points[i] = i;
+    srand( 1 );
+    for( i=0; i<numSegments; i++ ){
+        a = rand() % numPoints;
+        b = rand() % numPoints;
+        segmentStarts[i] = a < b ? a : b;
+        segmentEnds[i] = a < b ? b : a;
+    }
+
+    printf( "threads,seconds,million_segments_per_second,speedup\n" );
+    for( t=1; t<=maxThreads; t = t<maxThreads && t*2>maxThreads ? maxThreads : t*2 ){
+        st = createST( points, numPoints );
+        start = getWallTime( );
+        insertSegmentsST( st, segmentStarts, segmentEnds, numSegments, t );
+        end = getWallTime( );
+        freeST( st );
+        if( t==1 )
+            base = end - start;
+        printf( "%d,%.3lf,%.3lf,%.2lf\n", t, end - start, numSegments / (end - start) / 1e6, base / (end - start) );
+    }
+
+    free( segmentEnds );
+    free( segmentStarts );
+    free( points );
+}
+
+
+/**********  Functions for benchmarking AVL searches **********/
+
+/* benchTreeSearch
+ * input: the largest tree to build, the number of lookups per tree, and the number of keys per searchTreeBatch call
+ * output: none
+ *
+ * Prints the lookup rate of a searchTree loop and of searchTreeBatch for AVL trees of 2^16 keys and every fourth
+ * power of two up to maxKeys.  Keys are inserted and looked up in random order, so at the larger sizes almost
+ * every level of a search misses the cache.
+ */
+void benchTreeSearch( int maxKeys, int numLookups, int batchSize ){
+    int i, j, size, found;
+    double start, single, batched;
+    char **keys = createBenchKeys( maxKeys );
+    int *order = (int *)malloc( maxKeys*sizeof(int) );
+    Data *queries = (Data *)malloc( numLookups*sizeof(Data) );
+    Data **queryPtrs = (Data **)malloc( numLookups*sizeof(Data *) );
+    TNode **out = (TNode **)malloc( numLookups*sizeof(TNode *) );
+    Tree *t;
+
+    if( order==NULL || queries==NULL || queryPtrs==NULL || out==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+
+    printf( "keys,single_mlookups,batch_mlookups,speedup\n" );
+    for( size=1<<16; size<=maxKeys; size = size<maxKeys && size*4>maxKeys ? maxKeys : size*4 ){
+        srand( 1 );
+        for( i=0; i<size; i++ )
+            order[i] = i;
+        for( i=size-1; i>0; i-- ){
+            j = rand() % (i+1);
+            found = order[i];
+            order[i] = order[j];
+            order[j] = found;
+        }
+        t = createTree( );
+        t->type = AVL;
+        for( i=0; i<size; i++ )
+            insertTreeBalanced( t, createBenchData( keys[order[i]] ) );
+        for( i=0; i<numLookups; i++ ){
+            queries[i].key = keys[ rand() % size ];
+            queryPtrs[i] = &queries[i];
+        }
+
+        found = 0;
+        start = getWallTime( );
+        for( i=0; i<numLookups; i++ )
+            found += !searchTree( t, queryPtrs[i] )->leaf;
+        single = numLookups / (getWallTime( ) - start) / 1e6;
+
+        start = getWallTime( );
+        for( i=0; i<numLookups; i+=batchSize )
+            searchTreeBatch( t, &queryPtrs[i], numLookups-i < batchSize ? numLookups-i : batchSize, &out[i] );
+        batched = numLookups / (getWallTime( ) - start) / 1e6;
+        for( i=0; i<numLookups; i++ )
+            found -= !out[i]->leaf;
+
+        if( found != 0 )
+            fprintf( stderr, "searchTreeBatch disagrees with searchTree\n" );
+        printf( "%d,%.3lf,%.3lf,%.2lf\n", size, single, batched, batched / single );
+        freeTree( t );
+        if( size == maxKeys )
+            break;
+    }
+
+    for( i=0; i<maxKeys; i++ )
+        free( keys[i] );
+    free( keys );
+    free( out );
+    free( queryPtrs );
+    free( queries );
+    free( order );
+}
+
+
+/**********  Functions for benchmarking tree layouts **********/
+
+/* benchTreeLayout
+ * input: the largest tree to build and the number of lookups per tree
+ * output: none
+ *
+ * Prints the lookup rate of searchTree on an AVL tree of 1M keys and every tenfold size up to maxKeys, first on the
+ * live tree, whose nodes lie in the heap in insertion order, then after freezeTree has moved them into van Emde Boas
+ * order.  Keys are inserted and looked up in random order.  Each key costs about 200 bytes (its node and empty leaf,
+ * Data and string), so 100M keys need a machine with 20GB or more.
+ */
+void benchTreeLayout( long maxKeys, int numLookups ){
+    long i, j, size, swap;
+    int found;
+    double start, live, frozen, freezeSeconds;
+    char **keys = createBenchKeys( (int)maxKeys );
+    int *order = (int *)malloc( maxKeys*sizeof(int) );
+    Data *queries = (Data *)malloc( numLookups*sizeof(Data) );
+    Tree *t;
+
+    if( order==NULL || queries==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+
+    printf( "keys,live_mlookups,frozen_mlookups,speedup,freeze_seconds\n" );
+    for( size = maxKeys < 1000000 ? maxKeys : 1000000; ; size = size*10 < maxKeys ? size*10 : maxKeys ){
+        srand( 1 );
+        for( i=0; i<size; i++ )
+            order[i] = i;
+        for( i=size-1; i>0; i-- ){
+            j = ( (long)rand() * ((long)RAND_MAX + 1) + rand() ) % (i+1);
+            swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+        t = createTree( );
+        t->type = AVL;
+        for( i=0; i<size; i++ )
+            insertTreeBalanced( t, createBenchData( keys[order[i]] ) );
+        for( i=0; i<numLookups; i++ )
+            queries[i].key = keys[ ( (long)rand() * ((long)RAND_MAX + 1) + rand() ) % size ];
+
+        found = 0;
+        start = getWallTime( );
+        for( i=0; i<numLookups; i++ )
+            found += !searchTree( t, &queries[i] )->leaf;
+        live = numLookups / (getWallTime( ) - start) / 1e6;
+
+        start = getWallTime( );
+        if( !freezeTree( t ) ){
+            fprintf( stderr, "freezeTree failed at %ld keys\n", size );
+            exit(-1);
+        }
+        freezeSeconds = getWallTime( ) - start;
+
+        start = getWallTime( );
+        for( i=0; i<numLookups; i++ )
+            found -= !searchTree( t, &queries[i] )->leaf;
+        frozen = numLookups / (getWallTime( ) - start) / 1e6;
+
+        if( found != 0 )
+            fprintf( stderr, "the frozen tree disagrees with the live tree\n" );
+        printf( "%ld,%.3lf,%.3lf,%.2lf,%.3lf\n", size, live, frozen, frozen / live, freezeSeconds );
+        freeTree( t );
+        if( size == maxKeys )
+            break;
+    }
+
+    for( i=0; i<maxKeys; i++ )
+        free( keys[i] );
+    free( keys );
+    free( queries );
+    free( order );
+}
+
+
+/**********  Functions for benchmarking allocators **********/
+
+/* benchMemory
+ * input: the number of keys to insert
+ * output: none
+ *
+ * Builds an AVL tree of numKeys random keys (then removes half of them) and fills a PriorityQueue with numKeys
+ * nodes, once with malloc and once with a bump allocator, and prints the time taken and the memory each structure
+ * reports.  The Data stored in the tree is allocated by the benchmark and is not part of the tree's counts.
+ */
+void benchMemory( int numKeys ){
+    int i, j, k, swap;
+    double start, seconds;
+    char **keys = createBenchKeys( numKeys );
+    int *order = (int *)malloc( numKeys*sizeof(int) );
+    TNode *nodes = (TNode *)malloc( numKeys*sizeof(TNode) );
+    const char *names[2] = { "malloc", "bump" };
+    Allocator *allocator;
+    MemStats mem;
+    Tree *t;
+    PriorityQueue *ppq;
+
+    if( order==NULL || nodes==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    srand( 1 );
+    for( i=0; i<numKeys; i++ ){
+        order[i] = i;
+        nodes[i].priority = rand( );
+    }
+    for( i=numKeys-1; i>0; i-- ){
+        j = rand() % (i+1);
+        swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    printf( "structure,allocator,seconds,current_bytes,peak_bytes,allocs,frees,allocator_bytes\n" );
+    for( k=0; k<2; k++ ){
+        allocator = NULL;
+        if( k == 1 && ( allocator = createBumpAllocator( 1<<20 ) ) == NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+
+        t = createTreeWithAllocator( allocator );
+        t->type = AVL;
+        start = getWallTime( );
+        for( i=0; i<numKeys; i++ )
+            insertTreeBalanced( t, createBenchData( keys[order[i]] ) );
+        seconds = getWallTime( ) - start;
+        getTreeMemStats( t, &mem );
+        printMemoryRow( "avl_insert", names[k], allocator, seconds, &mem );
+
+        start = getWallTime( );
+        for( i=0; i<numKeys; i+=2 )
+            freeData( removeTree( t, keys[order[i]] ) );
+        seconds = getWallTime( ) - start;
+        getTreeMemStats( t, &mem );
+        printMemoryRow( "avl_remove_half", names[k], allocator, seconds, &mem );
+        freeTree( t );
+
+        ppq = createPQWithAllocator( allocator );
+        start = getWallTime( );
+        for( i=0; i<numKeys; i++ )
+            insertPQ( ppq, &nodes[i] );
+        seconds = getWallTime( ) - start;
+        getPQMemStats( ppq, &mem );
+        printMemoryRow( "pq_insert", names[k], allocator, seconds, &mem );
+        freePQ( ppq );
+
+        if( allocator != NULL )
+            freeBumpAllocator( allocator );
+    }
+
+    for( i=0; i<numKeys; i++ )
+        free( keys[i] );
+    free( keys );
+    free( nodes );
+    free( order );
+}
+
+/* printMemoryRow
+ * input: the names of the structure and allocator, the allocator (NULL for malloc), the seconds taken and the MemStats
+ * output: none
+ *
+ * Prints one CSV row of benchMemory; allocator_bytes is what a bump allocator took from malloc so far
+ */
+void printMemoryRow( const char *structure, const char *allocatorName, Allocator *allocator, double seconds, MemStats *mem ){
+    printf( "%s,%s,%.4lf,%zu,%zu,%lu,%lu,%zu\n", structure, allocatorName, seconds, mem->currentBytes, mem->peakBytes,
+            mem->numAllocs, mem->numFrees, allocator != NULL ? getBumpAllocatorSize( allocator ) : (size_t)0 );
+}
+
+
+/**********  Functions for benchmarking Huffman compression **********/
+
+/* runHuffmanBench
+ * input: the Huffman benchmark's command-line options
+ * output: none
+ *
+ * Generates a corpus of lowercase letters for each selected distribution and prints, as CSV, its entropy, the
+ * compression ratio reached against the ratio the entropy allows, and the throughput of every stage
+ */
+void runHuffmanBench( int argc, char *argv[] ){
+    static struct option options[] = {
+        { "size", required_argument, NULL, 'n' },
+        { "corpus", required_argument, NULL, 'c' },
+        { "zipf", required_argument, NULL, 'z' },
+        { "dominant", required_argument, NULL, 'p' },
+        { "reps", required_argument, NULL, 'r' },
+        { NULL, 0, NULL, 0 }
+    };
+    HuffmanBenchConfig cfg = { 1<<24, NUM_CORPORA, 1.0, 0.95, 5 };
+    char *text, *decoded;
+    unsigned char *encoded;
+    int c, corpus;
+
+    while( ( c = getopt_long( argc, argv, "n:c:z:p:r:", options, NULL ) ) != -1 ){
+        if( c == 'n' )
+            cfg.size = atol( optarg );
+        else if( c == 'z' )
+            cfg.zipfExponent = atof( optarg );
+        else if( c == 'p' )
+            cfg.dominant = atof( optarg );
+        else if( c == 'r' )
+            cfg.reps = atoi( optarg );
+        else if( c == 'c' ){
+            corpus = 0;
+            while( corpus<NUM_CORPORA && strcmp( optarg, getCorpusName( (corpusType)corpus ) )!=0 )
+                corpus++;
+            if( corpus == NUM_CORPORA && strcmp( optarg, "all" )!=0 ){
+                fprintf( stderr, "unknown corpus %s\n", optarg );
+                exit(-1);
+            }
+            cfg.corpus = corpus;
+        }
+        else{
+            fprintf( stderr, "usage: huffman [--size N] [--corpus uniform|zipf|english|single|all] [--zipf S] [--dominant P] [--reps R]\n" );
+            exit(-1);
+        }
+    }
+    if( cfg.size < 1 || cfg.size > INT_MAX ){
+        /* the character counts are ints */
+        fprintf( stderr, "--size must be between 1 and %d\n", INT_MAX );
+        exit(-1);
+    }
+    if( cfg.reps < 1 )
+        cfg.reps = 1;
+
+    text = (char *)malloc( cfg.size );
+    decoded = (char *)malloc( cfg.size );
+    encoded = (unsigned char *)malloc( (cfg.size*(HUFFMAN_ALPHABET-1) + 7)/8 );
+    if( text==NULL || decoded==NULL || encoded==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+
+    printf( "corpus,size,entropy_bits,code_bits,ratio,entropy_ratio,histogram_mbs,build_us,codes_us,encode_mbs,decode_mbs\n" );
+    for( corpus=0; corpus<NUM_CORPORA; corpus++ ){
+        if( cfg.corpus == NUM_CORPORA || cfg.corpus == corpus ){
+            createCorpus( &cfg, (corpusType)corpus, text );
+            benchHuffmanCorpus( &cfg, (corpusType)corpus, text, encoded, decoded );
+        }
+    }
+
+    free( encoded );
+    free( decoded );
+    free( text );
+}
+
+/* benchHuffmanCorpus
+ * input: the benchmark's configuration, the corpus type and text, and buffers for the encoded and decoded text
+ * output: none
+ *
+ * Times the histogram, tree build, code table, encode and decode stages cfg->reps times each and prints one CSV row
+ * of medians.  The tree and code table do not depend on the corpus size, so they are reported in microseconds per
+ * build rather than MB/s.  The ratio compares the encoded size with one byte per input character.
+ */
+void benchHuffmanCorpus( HuffmanBenchConfig *cfg, corpusType corpus, char *text, unsigned char *encoded, char *decoded ){
+    int i, r, charCounts[HUFFMAN_ALPHABET], lengths[HUFFMAN_ALPHABET];
+    unsigned int codes[HUFFMAN_ALPHABET];
+    double start, megabytes = cfg->size / 1e6, entropy;
+    double *histogram = (double *)malloc( 5*cfg->reps*sizeof(double) );
+    double *build = histogram + cfg->reps, *table = build + cfg->reps;
+    double *encode = table + cfg->reps, *decode = encode + cfg->reps;
+    long bits = 0;
+    Tree *pt;
+
+    if( histogram==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+
+    for( r=0; r<cfg->reps; r++ ){
+        start = getWallTime( );
+        countHuffmanChars( text, cfg->size, charCounts );
+        histogram[r] = getWallTime( ) - start;
+
+        start = getWallTime( );
+        for( i=0; i<HUFFMAN_BENCH_BUILDS; i++ )
+            freeTree( buildHuffmanTree( charCounts, NULL ) );
+        build[r] = ( getWallTime( ) - start ) / HUFFMAN_BENCH_BUILDS;
+
+        pt = buildHuffmanTree( charCounts, NULL );
+        start = getWallTime( );
+        for( i=0; i<HUFFMAN_BENCH_BUILDS; i++ )
+            getHuffmanCodes( pt->root, charCounts, codes, lengths );
+        table[r] = ( getWallTime( ) - start ) / HUFFMAN_BENCH_BUILDS;
+
+        memset( encoded, 0, (cfg->size*(HUFFMAN_ALPHABET-1) + 7)/8 );
+        start = getWallTime( );
+        bits = encodeHuffman( text, cfg->size, codes, lengths, encoded );
+        encode[r] = getWallTime( ) - start;
+
+        start = getWallTime( );
+        if( decodeHuffman( pt->root, encoded, cfg->size, decoded ) != bits || memcmp( text, decoded, cfg->size )!=0 )
+            fprintf( stderr, "decodeHuffman did not reproduce the %s corpus\n", getCorpusName( corpus ) );
+        decode[r] = getWallTime( ) - start;
+        freeTree( pt );
+    }
+
+    entropy = getEntropy( charCounts, cfg->size );
+    printf( "%s,%ld,%.4lf,%.4lf,%.4lf,%.4lf,%.1lf,%.2lf,%.2lf,%.1lf,%.1lf\n", getCorpusName( corpus ), cfg->size, entropy,
+            (double)bits / cfg->size, bits / 8.0 / cfg->size, entropy / 8, megabytes / getMedian( histogram, cfg->reps ),
+            getMedian( build, cfg->reps )*1e6, getMedian( table, cfg->reps )*1e6,
+            megabytes / getMedian( encode, cfg->reps ), megabytes / getMedian( decode, cfg->reps ) );
+    free( histogram );
+}
+
+/* createCorpus
+ * input: the benchmark's configuration, the corpus type and a buffer of cfg->size chars
+ * output: none
+ *
+ * Fills text with lowercase letters drawn independently from the corpus' distribution: every letter equally
+ * likely, Zipfian ranks with exponent cfg->zipfExponent, English letter frequencies, or 'e' with probability
+ * cfg->dominant and the other letters sharing the rest
+ */
+void createCorpus( HuffmanBenchConfig *cfg, corpusType corpus, char *text ){
+    static const double english[HUFFMAN_ALPHABET] = { 8.167, 1.492, 2.782, 4.253, 12.702, 2.228, 2.015, 6.094, 6.966,
+        0.153, 0.772, 4.025, 2.406, 6.749, 7.507, 1.929, 0.095, 5.987, 6.327, 9.056, 2.758, 0.978, 2.360, 0.150, 1.974, 0.074 };
+    double cdf[HUFFMAN_ALPHABET], sum = 0, u;
+    long i;
+    int c;
+
+    for( c=0; c<HUFFMAN_ALPHABET; c++ ){
+        if( corpus == CORPUS_UNIFORM )
+            sum += 1;
+        else if( corpus == CORPUS_ZIPF )
+            sum += pow( c+1, -cfg->zipfExponent );
+        else if( corpus == CORPUS_ENGLISH )
+            sum += english[c];
+        else
+            sum += c == 'e'-'a' ? cfg->dominant : (1 - cfg->dominant) / (HUFFMAN_ALPHABET-1);
+        cdf[c] = sum;
+    }
+
+    srand( 1 );
+    for( i=0; i<cfg->size; i++ ){
+        u = (double)rand() / ((double)RAND_MAX + 1) * sum;
+        c = 0;
+        while( c<HUFFMAN_ALPHABET-1 && cdf[c] <= u )
+            c++;
+        text[i] = 'a' + c;
+    }
+}
+
+/* getEntropy
+ * input: the count of each character and their total
+ * output: a double
+ *
+ * Returns the Shannon entropy of the counts in bits per character, the fewest bits any code can average
+ */
+double getEntropy( int charCounts[HUFFMAN_ALPHABET], long total ){
+    double entropy = 0, p;
+    int c;
+
+    for( c=0; c<HUFFMAN_ALPHABET; c++ ){
+        if( charCounts[c] > 0 ){
+            p = (double)charCounts[c] / total;
+            entropy -= p * log2( p );
+        }
+    }
+    return entropy;
+}
+
+/* getMedian
+ * input: an array of doubles and its length
+ * output: a double
+ *
+ * Sorts the values and returns their median
+ */
+double getMedian( double *values, int n ){
+    qsort( values, n, sizeof(double), compareSamples );
+    return n % 2 ? values[n/2] : ( values[n/2-1] + values[n/2] ) / 2;
+}
+
+const char *getCorpusName( corpusType corpus ){
+    static const char *names[NUM_CORPORA] = { "uniform", "zipf", "english", "single" };
+    return names[corpus];
+}
+
+
+/**********  Functions for benchmarking sharded maps **********/
+
+/* benchShardedMap
+ * input: the largest thread count to run, the number of shards, the size of the key space and the operations per thread
+ * output: none
+ *
+ * Prints the throughput of one AVL tree behind a single reader-writer lock, of a ShardedMap, and of a ShardedMap
+ * fed in batches, for several read/write mixes and 1 to maxThreads threads
+ */
+void benchShardedMap( int maxThreads, int numShards, int numKeys, int numOps ){
+    static const int readPercents[] = { 50, 90, 99 };
+    int i, r, t;
+    char **keys = createBenchKeys( numKeys );
+
+    printf( "read_percent,threads,global_lock_mops,sharded_mops,sharded_batch_mops\n" );
+    for( r=0; r<(int)(sizeof(readPercents)/sizeof(readPercents[0])); r++ ){
+        for( t=1; t<=maxThreads; t = t<maxThreads && t*2>maxThreads ? maxThreads : t*2 ){
+            double global = runMapBench( MAP_BENCH_SINGLE, 1, readPercents[r], t, keys, numKeys, numOps );
+            double sharded = runMapBench( MAP_BENCH_SINGLE, numShards, readPercents[r], t, keys, numKeys, numOps );
+            double batched = runMapBench( MAP_BENCH_BATCHED, numShards, readPercents[r], t, keys, numKeys, numOps );
+            printf( "%d,%d,%.3lf,%.3lf,%.3lf\n", readPercents[r], t, global, sharded, batched );
+        }
+    }
+
+    for( i=0; i<numKeys; i++ )
+        free( keys[i] );
+    free( keys );
+}
+
+/* benchOptimisticTree
+ * input: the largest thread count to run, the size of the key space and the operations per thread
+ * output: none
+ *
+ * Prints the throughput of one AVL tree behind a reader-writer lock and of an OptimisticTree, read-only and at
+ * about 50 reads per write, for 1 to maxThreads threads
+ */
+void benchOptimisticTree( int maxThreads, int numKeys, int numOps ){
+    static const int readPercents[] = { 98, 100 };
+    int i, r, t;
+    char **keys = createBenchKeys( numKeys );
+
+    printf( "read_percent,threads,rwlock_mops,optimistic_mops\n" );
+    for( r=0; r<(int)(sizeof(readPercents)/sizeof(readPercents[0])); r++ ){
+        for( t=1; t<=maxThreads; t = t<maxThreads && t*2>maxThreads ? maxThreads : t*2 ){
+            double locked = runMapBench( MAP_BENCH_SINGLE, 1, readPercents[r], t, keys, numKeys, numOps );
+            double optimistic = runMapBench( MAP_BENCH_OPTIMISTIC, 1, readPercents[r], t, keys, numKeys, numOps );
+            printf( "%d,%d,%.3lf,%.3lf\n", readPercents[r], t, locked, optimistic );
+        }
+    }
+
+    for( i=0; i<numKeys; i++ )
+        free( keys[i] );
+    free( keys );
+}
+
+/* createBenchKeys
+ * input: the size of the key space
+ * output: an array of keys (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates the keys "key00000000", "key00000001", ...
+ */
+char **createBenchKeys( int numKeys ){
+    int i;
+    char **keys = (char **)malloc( numKeys*sizeof(char *) );
+
+    if( keys==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    for( i=0; i<numKeys; i++ ){
+        keys[i] = (char *)malloc( 16 );
+        if( keys[i]==NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+        sprintf( keys[i], "key%08d", i );
+    }
+    return keys;
+}
+
+/* runMapBench
+ * input: the structure to use, the number of shards, the share of searches, the number of threads, the key space
+ *        and its size, and the number of operations per thread
+ * output: a double
+ *
+ * Fills a map with every other key and runs numThreads workers against it, returning the throughput in millions
+ * of operations per second.  Writes are split evenly between inserts and removes, so the map keeps its size.
+ */
+double runMapBench( mapBenchMode mode, int numShards, int readPercent, int numThreads, char **keys, int numKeys, int numOps ){
+    int i;
+    double start, end;
+    pthread_t *threads = (pthread_t *)malloc( numThreads*sizeof(pthread_t) );
+    MapBenchArgs *args = (MapBenchArgs *)malloc( numThreads*sizeof(MapBenchArgs) );
+    ShardedMap *map = mode != MAP_BENCH_OPTIMISTIC ? createShardedMap( numShards ) : NULL;
+    OptimisticTree *ot = mode == MAP_BENCH_OPTIMISTIC ? createOT( ) : NULL;
+
+    for( i=0; i<numKeys; i+=2 ){
+        if( ot != NULL )
+            insertOT( ot, createBenchData( keys[i] ) );
+        else
+            insertShardedMap( map, createBenchData( keys[i] ) );
+    }
+
+    for( i=0; i<numThreads; i++ ){
+        args[i].mode = mode;
+        args[i].map = map;
+        args[i].ot = ot;
+        args[i].keys = keys;
+        args[i].numKeys = numKeys;
+        args[i].readPercent = readPercent;
+        args[i].numOps = numOps;
+        args[i].seed = 2654435761u*(i+1);
+    }
+
+    start = getWallTime( );
+    for( i=0; i<numThreads; i++ )
+        pthread_create( &threads[i], NULL, mapBenchWorker, &args[i] );
+    for( i=0; i<numThreads; i++ )
+        pthread_join( threads[i], NULL );
+    end = getWallTime( );
+
+    if( ot != NULL )
+        freeOT( ot );
+    else
+        freeShardedMap( map );
+    free( args );
+    free( threads );
+
+    return (double)numOps*numThreads / (end - start) / 1e6;
+}
+
+/* mapBenchWorker
+ * input: a pointer to a MapBenchArgs
+ * output: NULL
+ *
+ * Performs random searches, inserts and removes on the shared map, one at a time or MAP_BATCH_SIZE at a time
+ */
+void *mapBenchWorker( void *arg ){
+    MapBenchArgs *a = (MapBenchArgs *)arg;
+    MapOp ops[MAP_BATCH_SIZE];
+    int i, j, n;
+
+    for( i=0; i<a->numOps; i+=n ){
+        n = a->mode != MAP_BENCH_BATCHED ? 1 : ( a->numOps - i > MAP_BATCH_SIZE ? MAP_BATCH_SIZE : a->numOps - i );
+        for( j=0; j<n; j++ )
+            fillMapOp( a, &ops[j] );
+
+        if( a->mode == MAP_BENCH_BATCHED )
+            applyShardedMapBatch( a->map, ops, n );
+        else if( a->mode == MAP_BENCH_OPTIMISTIC ){
+            if( ops[0].type == MAP_SEARCH )
+                ops[0].ok = searchOT( a->ot, ops[0].key, NULL );
+            else if( ops[0].type == MAP_INSERT )
+                ops[0].ok = insertOT( a->ot, ops[0].data );
+            else
+                ops[0].ok = removeOT( a->ot, ops[0].key );  /* the tree frees what it removes */
+        }
+        else if( ops[0].type == MAP_SEARCH )
+            ops[0].result = searchShardedMap( a->map, ops[0].key );
+        else if( ops[0].type == MAP_INSERT )
+            ops[0].ok = insertShardedMap( a->map, ops[0].data );
+        else
+            ops[0].result = removeShardedMap( a->map, ops[0].key );
+
+        /* release rejected inserts and removed elements */
+        for( j=0; j<n; j++ ){
+            if( ops[j].type == MAP_INSERT && !ops[j].ok )
+                freeData( ops[j].data );
+            if( ops[j].type == MAP_REMOVE && ops[j].result != NULL )
+                freeData( ops[j].result );
+        }
+    }
+    return NULL;
+}
+
+/* fillMapOp
+ * input: a pointer to a MapBenchArgs and a MapOp
+ * output: none
+ *
+ * Draws the next random operation of a worker
+ */
+void fillMapOp( MapBenchArgs *a, MapOp *op ){
+    unsigned int x;
+
+    x = a->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    a->seed = x;
+
+    op->key = a->keys[ (x >> 8) % a->numKeys ];
+    op->result = NULL;
+    op->ok = false;
+    if( (int)(x % 100) < a->readPercent )
+        op->type = MAP_SEARCH;
+    else if( x & 128 ){
+        op->type = MAP_INSERT;
+        op->data = createBenchData( op->key );
+    }
+    else
+        op->type = MAP_REMOVE;
+}
+
+/* createBenchData
+ * input: a key
+ * output: a Data* (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates a Data holding a copy of key
+ */
+Data *createBenchData( char *key ){
+    Data *d = (Data *)malloc( sizeof(Data) );
+    if( d==NULL || ( d->key = strdup( key ) )==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    d->verification = 0;
+    return d;
+}
+
+
+/**********  Functions for benchmarking persistent trees **********/
+
+/* benchPersistentTree
+ * input: the number of keys and the number of updates made by the writer
+ * output: none
+ *
+ * Compares building an AVL tree and a PersistentTree of numKeys random keys, then measures the cost of a snapshot
+ * and the writer's update rate, first alone and then while a reader keeps taking snapshots and checking that each
+ * one is a complete, sorted version
+ */
+void benchPersistentTree( int numKeys, int numOps ){
+    int i;
+    double start;
+    char **keys = createBenchKeys( numKeys );
+    Tree *t = createTree( );
+    PersistentTree *pt = createPT( );
+    PTSnapshot snap;
+    PTBenchArgs args;
+    pthread_t writer, reader;
+
+    t->type = AVL;
+    printf( "operation,seconds,ns_per_op\n" );
+    start = getWallTime( );
+    for( i=0; i<numKeys; i++ )
+        insertTreeBalanced( t, createBenchData( keys[i] ) );
+    printf( "avl_insert,%.4lf,%.1lf\n", getWallTime( ) - start, (getWallTime( ) - start) / numKeys * 1e9 );
+    freeTree( t );
+
+    start = getWallTime( );
+    for( i=0; i<numKeys; i++ )
+        insertPT( pt, createBenchData( keys[i] ) );
+    printf( "persistent_insert,%.4lf,%.1lf\n", getWallTime( ) - start, (getWallTime( ) - start) / numKeys * 1e9 );
+
+    start = getWallTime( );
+    for( i=0; i<1000000; i++ ){
+        snap = snapshotPT( pt );
+        releasePTSnapshot( &snap );
+    }
+    printf( "snapshot,%.4lf,%.1lf\n", getWallTime( ) - start, (getWallTime( ) - start) / 1000000 * 1e9 );
+
+    args.pt = pt;
+    args.keys = keys;
+    args.numKeys = numKeys;
+    args.numOps = numOps;
+    args.done = false;
+    args.numSnapshots = args.numErrors = 0;
+    start = getWallTime( );
+    ptWriterWorker( &args );
+    printf( "update_alone,%.4lf,%.1lf\n", getWallTime( ) - start, (getWallTime( ) - start) / (numOps > 0 ? numOps : 1) * 1e9 );
+
+    args.done = false;
+    start = getWallTime( );
+    pthread_create( &reader, NULL, ptReaderWorker, &args );
+    pthread_create( &writer, NULL, ptWriterWorker, &args );
+    pthread_join( writer, NULL );
+    pthread_join( reader, NULL );
+    printf( "update_with_reader,%.4lf,%.1lf\n", getWallTime( ) - start, (getWallTime( ) - start) / (numOps > 0 ? numOps : 1) * 1e9 );
+    printf( "reader checked %ld snapshots, %ld inconsistent\n", args.numSnapshots, args.numErrors );
+
+    freePT( pt );
+    for( i=0; i<numKeys; i++ )
+        free( keys[i] );
+    free( keys );
+}
+
+/* ptWriterWorker and ptReaderWorker
+ * input: a pointer to a PTBenchArgs
+ * output: NULL
+ *
+ * The writer removes a random key and inserts it back, numOps updates in all, so every version holds either all
+ * keys or all but one.  The reader takes snapshots until the writer is done and scans each one.
+ */
+void *ptWriterWorker( void *arg ){
+    PTBenchArgs *a = (PTBenchArgs *)arg;
+    unsigned int seed = 7;
+    int i, k;
+
+    for( i=0; i+1<a->numOps; i+=2 ){
+        k = rand_r( &seed ) % a->numKeys;
+        removePT( a->pt, a->keys[k] );
+        insertPT( a->pt, createBenchData( a->keys[k] ) );
+    }
+    __atomic_store_n( &a->done, true, __ATOMIC_RELEASE );
+    return NULL;
+}
+
+void *ptReaderWorker( void *arg ){
+    PTBenchArgs *a = (PTBenchArgs *)arg;
+    PTSnapshot snap;
+    PTScanState scan;
+
+    do{
+        snap = snapshotPT( a->pt );
+        scan.last = NULL;
+        scan.count = 0;
+        scan.sorted = true;
+        scanPTSnapshot( &snap, checkSnapshotKey, &scan );
+        if( !scan.sorted || scan.count != snap.size || snap.size < a->numKeys-1 )
+            a->numErrors++;
+        a->numSnapshots++;
+        releasePTSnapshot( &snap );
+    } while( !__atomic_load_n( &a->done, __ATOMIC_ACQUIRE ) );
+    return NULL;
+}
+
+void checkSnapshotKey( Data *d, void *arg ){
+    PTScanState *scan = (PTScanState *)arg;
+
+    if( scan->last != NULL && strcmp( scan->last, d->key ) >= 0 )
+        scan->sorted = false;
+    scan->last = d->key;
+    scan->count++;
+}
+
+
+/**********  Functions for the benchmark suite **********/
+
+/* runSuite
+ * input: the suite's command-line options
+ * output: none
+ *
+ * Runs every phase of the suite reps times on numThreads threads and prints (and optionally saves as JSON) the
+ * median and 99th percentile time per operation and the throughput of each phase.  Each thread works on its own
+ * structures; all threads start every phase together, so the throughput shows how the phases scale when several
+ * cores share the memory system.
+ */
+void runSuite( int argc, char *argv[] ){
+    static struct option options[] = {
+        { "size", required_argument, NULL, 'n' },
+        { "dist", required_argument, NULL, 'd' },
+        { "threads", required_argument, NULL, 't' },
+        { "reps", required_argument, NULL, 'r' },
+        { "json", required_argument, NULL, 'o' },
+        { NULL, 0, NULL, 0 }
+    };
+    SuiteConfig cfg = { 100000, DIST_RANDOM, 1, 5, NULL };
+    SuiteState *states;
+    pthread_t *threads;
+    pthread_barrier_t barrier;
+    char **keys;
+    double *zipfKeys, *zipfChars;
+    int c, t;
+
+    while( ( c = getopt_long( argc, argv, "n:d:t:r:o:", options, NULL ) ) != -1 ){
+        if( c == 'n' )
+            cfg.size = atoi( optarg );
+        else if( c == 't' )
+            cfg.numThreads = atoi( optarg );
+        else if( c == 'r' )
+            cfg.reps = atoi( optarg );
+        else if( c == 'o' )
+            cfg.jsonFile = optarg;
+        else if( c == 'd' && strcmp( optarg, "sequential" )==0 )
+            cfg.dist = DIST_SEQUENTIAL;
+        else if( c == 'd' && strcmp( optarg, "random" )==0 )
+            cfg.dist = DIST_RANDOM;
+        else if( c == 'd' && strcmp( optarg, "zipf" )==0 )
+            cfg.dist = DIST_ZIPF;
+        else{
+            fprintf( stderr, "usage: benchmark suite [--size N] [--dist sequential|random|zipf] [--threads T] [--reps R] [--json FILE]\n" );
+            exit(-1);
+        }
+    }
+    if( cfg.size < 1 || cfg.numThreads < 1 || cfg.reps < 1 ){
+        fprintf( stderr, "size, threads and reps must be positive\n" );
+        exit(-1);
+    }
+
+    keys = createBenchKeys( cfg.size );
+    zipfKeys = createZipfTable( cfg.size );
+    zipfChars = createZipfTable( HUFFMAN_ALPHABET );
+    states = (SuiteState *)calloc( cfg.numThreads, sizeof(SuiteState) );
+    threads = (pthread_t *)malloc( cfg.numThreads*sizeof(pthread_t) );
+    if( states==NULL || threads==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    pthread_barrier_init( &barrier, NULL, cfg.numThreads );
+
+    for( t=0; t<cfg.numThreads; t++ ){
+        states[t].cfg = &cfg;
+        states[t].keys = keys;
+        states[t].zipfKeys = zipfKeys;
+        states[t].zipfChars = zipfChars;
+        states[t].seed = 0x9E3779B97F4A7C15ull*(t+1);
+        states[t].barrier = &barrier;
+        states[t].phaseStart = (double *)malloc( NUM_PHASES*cfg.reps*sizeof(double) );
+        states[t].phaseEnd = (double *)malloc( NUM_PHASES*cfg.reps*sizeof(double) );
+        states[t].samples = (double *)malloc( (size_t)NUM_PHASES*cfg.reps*SUITE_BLOCKS*sizeof(double) );
+        if( states[t].phaseStart==NULL || states[t].phaseEnd==NULL || states[t].samples==NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+    }
+    for( t=0; t<cfg.numThreads; t++ )
+        pthread_create( &threads[t], NULL, suiteWorker, &states[t] );
+    for( t=0; t<cfg.numThreads; t++ )
+        pthread_join( threads[t], NULL );
+
+    reportSuite( &cfg, states );
+
+    for( t=0; t<cfg.numThreads; t++ ){
+        free( states[t].phaseStart );
+        free( states[t].phaseEnd );
+        free( states[t].samples );
+    }
+    pthread_barrier_destroy( &barrier );
+    for( t=0; t<cfg.size; t++ )
+        free( keys[t] );
+    free( keys );
+    free( zipfKeys );
+    free( zipfChars );
+    free( threads );
+    free( states );
+}
+
+/* suiteWorker
+ * input: a pointer to a SuiteState
+ * output: NULL
+ *
+ * Runs every repetition of every phase, timing each phase in SUITE_BLOCKS blocks of consecutive operations
+ */
+void *suiteWorker( void *arg ){
+    SuiteState *s = (SuiteState *)arg;
+    int rep, p, k, blocks, slot;
+    long ops, begin, end;
+    double blockStart, blockEnd;
+
+    for( rep=0; rep<s->cfg->reps; rep++ ){
+        prepareSuiteRep( s );
+        for( p=0; p<NUM_PHASES; p++ ){
+            ops = getSuiteOps( s->cfg, (suitePhase)p );
+            blocks = ops < SUITE_BLOCKS ? (int)ops : SUITE_BLOCKS;
+            slot = p*s->cfg->reps + rep;
+
+            pthread_barrier_wait( s->barrier );
+            s->phaseStart[slot] = blockEnd = getWallTime( );
+            for( k=0; k<blocks; k++ ){
+                begin = ops*k/blocks;
+                end = ops*(k+1)/blocks;
+                blockStart = blockEnd;
+                runSuitePhase( s, (suitePhase)p, begin, end );
+                blockEnd = getWallTime( );
+                s->samples[(size_t)slot*SUITE_BLOCKS + k] = (blockEnd - blockStart)*1e9 / (end - begin);
+            }
+            s->phaseEnd[slot] = blockEnd;
+        }
+        finishSuiteRep( s );
+    }
+    return NULL;
+}
+
+/* prepareSuiteRep
+ * input: a pointer to a SuiteState
+ * output: none
+ *
+ * Generates the inputs of one repetition from the configured distribution and allocates its structures.
+ * Keys are inserted in sequential or shuffled order (a Zipfian insert order would repeat keys), while searches,
+ * priorities, characters and segment coordinates follow the distribution directly.
+ */
+void prepareSuiteRep( SuiteState *s ){
+    int i, j, tmp, n = s->cfg->size;
+    keyDist dist = s->cfg->dist;
+
+    s->order = (int *)malloc( n*sizeof(int) );
+    s->inserts = (Data **)malloc( n*sizeof(Data *) );
+    s->queries = (Data *)malloc( n*sizeof(Data) );
+    s->removed = (Data **)malloc( n*sizeof(Data *) );
+    s->pqNodes = (TNode *)malloc( n*sizeof(TNode) );
+    s->text = (char *)malloc( n );
+    s->encoded = (unsigned char *)malloc( ((size_t)n*(HUFFMAN_ALPHABET-1) + 7)/8 );
+    s->positions = (double *)malloc( 2*(size_t)n*sizeof(double) );
+    s->points = (double *)malloc( 2*(size_t)n*sizeof(double) );
+    s->segmentStarts = (int *)malloc( n*sizeof(int) );
+    s->segmentEnds = (int *)malloc( n*sizeof(int) );
+    s->queryRanks = (int *)malloc( n*sizeof(int) );
+    if( s->order==NULL || s->inserts==NULL || s->queries==NULL || s->removed==NULL || s->pqNodes==NULL || s->text==NULL ||
+        s->encoded==NULL || s->positions==NULL || s->points==NULL || s->segmentStarts==NULL || s->segmentEnds==NULL ||
+        s->queryRanks==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+
+    for( i=0; i<n; i++ )
+        s->order[i] = i;
+    for( i=n-1; i>0 && dist != DIST_SEQUENTIAL; i-- ){
+        j = nextSuiteRandom( s ) % (i+1);
+        tmp = s->order[i];
+        s->order[i] = s->order[j];
+        s->order[j] = tmp;
+    }
+
+    s->tree = createTree( );
+    s->tree->type = AVL;
+    s->ppq = createPQ( );
+    for( i=0; i<n; i++ ){
+        s->inserts[i] = createBenchData( s->keys[ s->order[i] ] );
+        /* a Zipfian rank goes through the shuffled order so that the hot keys are spread over the tree */
+        j = sampleDist( s, dist, s->zipfKeys, n, i );
+        s->queries[i].key = s->keys[ dist == DIST_ZIPF ? s->order[j] : j ];
+        s->pqNodes[i].priority = sampleDist( s, dist, s->zipfKeys, n, i );
+        s->text[i] = 'a' + sampleDist( s, dist, s->zipfChars, HUFFMAN_ALPHABET, i );
+        s->positions[2*i] = sampleDist( s, dist, s->zipfKeys, n, i );
+        s->positions[2*i+1] = dist == DIST_SEQUENTIAL ? i + 1 + i%16 : sampleDist( s, dist, s->zipfKeys, n, i );
+    }
+    for( i=0; i<n; i++ )
+        s->queryRanks[i] = sampleDist( s, dist, s->zipfKeys, n, i );
+    s->st = NULL;
+}
+
+/* finishSuiteRep
+ * input: a pointer to a SuiteState
+ * output: none
+ *
+ * Frees the structures and inputs of one repetition
+ */
+void finishSuiteRep( SuiteState *s ){
+    int i;
+    for( i=0; i<s->cfg->size; i++ )
+        if( s->removed[i] != NULL )
+            freeData( s->removed[i] );
+    freeTree( s->tree );
+    freePQ( s->ppq );
+    freeST( s->st );
+    free( s->order );
+    free( s->inserts );
+    free( s->queries );
+    free( s->removed );
+    free( s->pqNodes );
+    free( s->text );
+    free( s->encoded );
+    free( s->positions );
+    free( s->points );
+    free( s->segmentStarts );
+    free( s->segmentEnds );
+    free( s->queryRanks );
+}
+
+/* getSuiteOps
+ * input: the suite configuration and a phase
+ * output: the number of operations the phase performs per repetition
+ */
+long getSuiteOps( SuiteConfig *cfg, suitePhase phase ){
+    if( phase == PHASE_HUFFMAN_BUILD )
+        return ( cfg->size + SUITE_HUFFMAN_CHUNK - 1 ) / SUITE_HUFFMAN_CHUNK;
+    return cfg->size;
+}
+
+/* runSuitePhase
+ * input: a pointer to a SuiteState, a phase, and the range of its operations to perform
+ * output: none
+ *
+ * Performs operations begin to end-1 of the phase.  The first block of PHASE_SEGMENT_BUILD also sorts the
+ * points, creates the tree and maps every coordinate to its rank; the later blocks insert the segments.
+ */
+void runSuitePhase( SuiteState *s, suitePhase phase, long begin, long end ){
+    long i, length;
+    int charCounts[HUFFMAN_ALPHABET], a, b;
+    Tree *huffman;
+
+    switch( phase ){
+    case PHASE_AVL_INSERT:
+        for( i=begin; i<end; i++ )
+            insertTreeBalanced( s->tree, s->inserts[i] );
+        break;
+    case PHASE_AVL_SEARCH:
+        for( i=begin; i<end; i++ )
+            s->checksum += !searchTree( s->tree, &s->queries[i] )->leaf;
+        break;
+    case PHASE_AVL_REMOVE:
+        for( i=begin; i<end; i++ )
+            s->removed[i] = removeTree( s->tree, s->keys[ s->order[i] ] );
+        break;
+    case PHASE_PQ_INSERT:
+        for( i=begin; i<end; i++ )
+            insertPQ( s->ppq, &s->pqNodes[i] );
+        break;
+    case PHASE_PQ_REMOVE:
+        for( i=begin; i<end; i++ )
+            s->checksum += removePQ( s->ppq )->priority;
+        break;
+    case PHASE_HUFFMAN_BUILD:
+        for( i=begin; i<end; i++ ){
+            length = s->cfg->size - i*SUITE_HUFFMAN_CHUNK;
+            countHuffmanChars( s->text + i*SUITE_HUFFMAN_CHUNK, length < SUITE_HUFFMAN_CHUNK ? length : SUITE_HUFFMAN_CHUNK, charCounts );
+            huffman = buildHuffmanTree( charCounts, NULL );
+            s->checksum += huffman->root->priority;
+            freeTree( huffman );
+        }
+        break;
+    case PHASE_HUFFMAN_ENCODE:
+        if( begin == 0 ){
+            countHuffmanChars( s->text, s->cfg->size, charCounts );
+            huffman = buildHuffmanTree( charCounts, NULL );
+            getHuffmanCodes( huffman->root, charCounts, s->codes, s->lengths );
+            freeTree( huffman );
+            memset( s->encoded, 0, ((size_t)s->cfg->size*(HUFFMAN_ALPHABET-1) + 7)/8 );
+        }
+        s->checksum += encodeHuffman( s->text + begin, end - begin, s->codes, s->lengths, s->encoded );
+        break;
+    case PHASE_SEGMENT_BUILD:
+        if( begin == 0 ){
+            memcpy( s->points, s->positions, 2*(size_t)s->cfg->size*sizeof(double) );
+            s->numPoints = sortUniqueDoubles( s->points, 2*s->cfg->size, getNumCPUs( ) );
+            s->st = createST( s->points, s->numPoints );
+            for( i=0; i<s->cfg->size; i++ ){
+                a = getRankST( s->st, s->positions[2*i] );
+                b = getRankST( s->st, s->positions[2*i+1] );
+                s->segmentStarts[i] = a < b ? a : b;
+                s->segmentEnds[i] = a < b ? b : a;
+            }
+        }
+        for( i=begin; i<end; i++ )
+            insertST( s->st, s->segmentStarts[i], s->segmentEnds[i] );
+        break;
+    case PHASE_SEGMENT_QUERY:
+        for( i=begin; i<end; i++ )
+            s->checksum += lineStabQueryST( s->st, s->queryRanks[i] % s->numPoints );
+        break;
+    default:
+        break;
+    }
+}
+
+/* reportSuite
+ * input: the suite configuration and the state of every thread
+ * output: none
+ *
+ * Prints one CSV row per phase and writes the JSON report.  The time per operation is taken from every timed
+ * block of every thread and repetition; the throughput is the median over the repetitions of all threads'
+ * operations divided by the phase's wall-clock time, from the first thread starting to the last one finishing.
+ */
+void reportSuite( SuiteConfig *cfg, SuiteState *states ){
+    int p, r, t, k, blocks, numSamples;
+    long ops;
+    double first, last, median, p99, throughput;
+    double *samples = (double *)malloc( (size_t)cfg->numThreads*cfg->reps*SUITE_BLOCKS*sizeof(double) );
+    double *rates = (double *)malloc( cfg->reps*sizeof(double) );
+    FILE *json = NULL;
+
+    if( samples==NULL || rates==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    if( cfg->jsonFile != NULL && ( json = fopen( cfg->jsonFile, "w" ) ) == NULL )
+        fprintf( stderr, "Cannot create %s.\n", cfg->jsonFile );
+    if( json != NULL )
+        fprintf( json, "{\n  \"config\": {\"size\": %d, \"distribution\": \"%s\", \"threads\": %d, \"repetitions\": %d},\n  \"phases\": [\n",
+                 cfg->size, getDistName( cfg->dist ), cfg->numThreads, cfg->reps );
+
+    printf( "phase,ops_per_rep,median_ns_per_op,p99_ns_per_op,ops_per_sec\n" );
+    for( p=0; p<NUM_PHASES; p++ ){
+        ops = getSuiteOps( cfg, (suitePhase)p );
+        blocks = ops < SUITE_BLOCKS ? (int)ops : SUITE_BLOCKS;
+        numSamples = 0;
+        for( r=0; r<cfg->reps; r++ ){
+            first = states[0].phaseStart[p*cfg->reps + r];
+            last = states[0].phaseEnd[p*cfg->reps + r];
+            for( t=0; t<cfg->numThreads; t++ ){
+                if( states[t].phaseStart[p*cfg->reps + r] < first )
+                    first = states[t].phaseStart[p*cfg->reps + r];
+                if( states[t].phaseEnd[p*cfg->reps + r] > last )
+                    last = states[t].phaseEnd[p*cfg->reps + r];
+                for( k=0; k<blocks; k++ )
+                    samples[numSamples++] = states[t].samples[(size_t)(p*cfg->reps + r)*SUITE_BLOCKS + k];
+            }
+            rates[r] = (double)ops*cfg->numThreads / (last - first);
+        }
+        qsort( samples, numSamples, sizeof(double), compareSamples );
+        qsort( rates, cfg->reps, sizeof(double), compareSamples );
+        median = samples[numSamples/2];
+        p99 = samples[(int)(0.99*(numSamples-1))];
+        throughput = rates[cfg->reps/2];
+
+        printf( "%s,%ld,%.1lf,%.1lf,%.0lf\n", getPhaseName( (suitePhase)p ), ops, median, p99, throughput );
+        if( json != NULL )
+            fprintf( json, "    {\"phase\": \"%s\", \"ops_per_rep\": %ld, \"median_ns_per_op\": %.1lf, \"p99_ns_per_op\": %.1lf, \"ops_per_sec\": %.0lf}%s\n",
+                     getPhaseName( (suitePhase)p ), ops, median, p99, throughput, p+1 < NUM_PHASES ? "," : "" );
+    }
+
+    if( json != NULL ){
+        fprintf( json, "  ]\n}\n" );
+        fclose( json );
+    }
+    free( rates );
+    free( samples );
+}
+
+/* getPhaseName and getDistName
+ * input: a suitePhase / a keyDist
+ * output: a string
+ *
+ * Return the names used in suite reports
+ */
+const char *getPhaseName( suitePhase phase ){
+    static const char *names[NUM_PHASES] = { "avl_insert", "avl_search", "avl_remove", "pq_insert", "pq_remove",
+                                             "huffman_build", "huffman_encode", "segment_build", "segment_query" };
+    return names[phase];
+}
+
+const char *getDistName( keyDist dist ){
+    if( dist == DIST_SEQUENTIAL )
+        return "sequential";
+    if( dist == DIST_ZIPF )
+        return "zipf";
+    return "random";
+}
+
+/* createZipfTable
+ * input: the number of ranks
+ * output: an array of doubles (this is malloc-ed so must be freed eventually!)
+ *
+ * Returns the cumulative probabilities of a Zipf distribution with exponent SUITE_ZIPF_EXPONENT over n ranks
+ */
+double *createZipfTable( int n ){
+    int i;
+    double sum = 0;
+    double *cdf = (double *)malloc( n*sizeof(double) );
+
+    if( cdf==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    for( i=0; i<n; i++ ){
+        sum += pow( i+1, -SUITE_ZIPF_EXPONENT );
+        cdf[i] = sum;
+    }
+    for( i=0; i<n; i++ )
+        cdf[i] /= sum;
+    return cdf;
+}
+
+/* sampleDist
+ * input: a pointer to a SuiteState, a distribution, its Zipf table, the number of values n and the index of the sample
+ * output: an int in [0, n)
+ *
+ * Returns i mod n for DIST_SEQUENTIAL, a uniform value for DIST_RANDOM, and a Zipfian rank for DIST_ZIPF
+ */
+int sampleDist( SuiteState *s, keyDist dist, double *zipf, int n, long i ){
+    int lo = 0, hi = n-1, mid;
+    double u;
+
+    if( dist == DIST_SEQUENTIAL )
+        return i % n;
+    if( dist == DIST_RANDOM )
+        return nextSuiteRandom( s ) % n;
+
+    u = (nextSuiteRandom( s ) >> 11) * (1.0/9007199254740992.0);
+    while( lo < hi ){
+        mid = lo + (hi - lo)/2;
+        if( zipf[mid] < u )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* nextSuiteRandom
+ * input: a pointer to a SuiteState
+ * output: a 64-bit pseudo-random number
+ *
+ * Steps the thread's xorshift64* generator
+ */
+unsigned long long nextSuiteRandom( SuiteState *s ){
+    s->seed ^= s->seed >> 12;
+    s->seed ^= s->seed << 25;
+    s->seed ^= s->seed >> 27;
+    return s->seed * 2685821657736338717ull;
+}
+
+int compareSamples( const void *a, const void *b ){
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
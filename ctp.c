@@ -0,0 +1,310 @@
+#include "ctp.h"
+#include "radixSort.h"
+
+/**********  Functions for reading CTP files **********/
+
+void readArray( char *fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves ){
+    double* moveSequence;
+
+    *pnumMoves = 0;
+    *pprovidedSolution = -1;
+
+    int i;
+
+    if( fileName != NULL ){
+        FILE *in_file = fopen(fileName, "r");
+
+        if(in_file == NULL)
+        {
+            printf("File %s not found.\n", fileName);
+            exit(-1);
+        }
+
+        /* read the number of nodes from file and allocate space to store them */
+        if( fscanf( in_file, "%d%d", pnumMoves, pprovidedSolution ) != 2 )
+        {
+            printf( "Invalid file format.  First line should be number of moves followed by the correct solution (or -1 if none is provided)\n");
+            exit(-1);
+        }
+        if( *pnumMoves < 0 )
+        {
+            printf( "The number moves must be non-negative.\n");
+            exit(-1);
+        }
+
+        (*pmoveSequence) = (double*) malloc( (*pnumMoves)*sizeof( double ) );
+        moveSequence = (*pmoveSequence);
+        /* read in names of nodes */
+        for( i=0 ; i<(*pnumMoves); i++)
+        {
+            if( fscanf( in_file, "%lf", &moveSequence[i] ) != 1 )
+            {
+                printf( "Failed to read %dth double in the move sequence", i );
+                exit(-1);
+            }
+        }
+        fclose( in_file );
+    }
+}
+
+
+/**********  Functions for solving the CTP **********/
+
+/* carTraversalTree
+ * input: an array of moves, its length and the most threads to use
+ * output: the maximum number of times any point is traversed
+ *
+ * Solves the CTP by inserting every move into a segment tree and stabbing it at every unique point.
+ * Every position is first compressed to its rank among the unique points, so the tree only ever compares
+ * ints.  Frees moveSequence.  Returns -1 if memory runs out.
+ */
+int carTraversalTree( double moveSequence[], int numMoves, int numThreads ){
+    int i, max;
+    double* positions = (double*) malloc( (numMoves+1)*sizeof( double ) );
+    double* points = (double*) malloc( (numMoves+1)*sizeof( double ) );
+    int* ranks = (int*) malloc( (numMoves+1)*sizeof( int ) );
+    int* ends = NULL;
+    SegmentTree* st = NULL;
+
+    if( positions==NULL || points==NULL || ranks==NULL ){
+        max = -1;
+        goto cleanup;
+    }
+    computeSegments( moveSequence, numMoves, NULL, NULL, positions );
+
+    /* Sort the points and remove all duplicates */
+    memcpy( points, positions, (numMoves+1)*sizeof( double ) );
+    int numUnique = sortUniqueDoubles( points, numMoves+1, numThreads );
+
+    /* build the segment tree and map every position to its rank once, starting each search from the
+     * previous position's rank since a move rarely jumps far */
+    st = createST( points, numUnique );
+    if( st==NULL ){
+        max = -1;
+        goto cleanup;
+    }
+    ranks[0] = getRankST( st, positions[0] );
+    for( i=1 ; i<=numMoves; i++)
+        ranks[i] = getRankNearST( st, positions[i], ranks[i-1] );
+    free( positions );
+    positions = NULL;
+    ends = (int*) malloc( (numMoves > 0 ? numMoves : 1)*sizeof( int ) );
+    if( ends==NULL ){
+        max = -1;
+        goto cleanup;
+    }
+
+    /* turn the path of ranks into segments: ranks[i] becomes the start and ends[i] the end of move i */
+    for( i=0 ; i<numMoves; i++)
+    {
+        if( ranks[i] < ranks[i+1] )
+            ends[i] = ranks[i+1];
+        else{
+            ends[i] = ranks[i];
+            ranks[i] = ranks[i+1];
+        }
+    }
+    insertSegmentsST( st, ranks, ends, numMoves, numMoves >= CTP_PARALLEL_INSERT_THRESHOLD ? numThreads : 1 );
+
+    /* query the segment tree at every point in one pass */
+    max = batchStabQueryST( st, NULL );
+
+cleanup:
+    freeST( st );
+    free( positions );
+    free( ends );
+    free( ranks );
+    free( points );
+    free( moveSequence );
+
+    return max;
+}
+
+/* carTraversalSweep
+ * input: an array of moves, its length and the most threads to use
+ * output: the maximum number of times any point is traversed
+ *
+ * Solves the CTP without a tree: the segment starts and ends are sorted separately and swept once in order,
+ * keeping a running count of open segments.  Segments are closed, so a start is processed before an end
+ * at the same coordinate.  Frees moveSequence.  Returns -1 if memory runs out.
+ */
+int carTraversalSweep( double moveSequence[], int numMoves, int numThreads ){
+    int i = 0, j = 0, cur = 0, max = 0;
+    double* segmentStartArray = (double*) malloc( numMoves*sizeof( double ) );
+    double* segmentEndArray = (double*) malloc( numMoves*sizeof( double ) );
+
+    if( numMoves > 0 && ( segmentStartArray==NULL || segmentEndArray==NULL ) ){
+        free( segmentStartArray );
+        free( segmentEndArray );
+        free( moveSequence );
+        return -1;
+    }
+
+    computeSegments( moveSequence, numMoves, segmentStartArray, segmentEndArray, NULL );
+    sortDoubles( segmentStartArray, numMoves, numThreads );
+    sortDoubles( segmentEndArray, numMoves, numThreads );
+
+    /* every end is preceded by its own start, so the starts run out first */
+    while( i<numMoves ){
+        if( segmentStartArray[i] <= segmentEndArray[j] ){
+            cur++;
+            i++;
+            if( cur>max )
+                max = cur;
+        }
+        else{
+            cur--;
+            j++;
+        }
+    }
+
+    free( segmentStartArray );
+    free( segmentEndArray );
+    free( moveSequence );
+
+    return max;
+}
+
+/* carTraversalDynamic
+ * input: an array of moves, its length and the most threads to use
+ * output: the maximum number of times any point is traversed
+ *
+ * Solves the CTP with a DynamicSegmentTree, reading the maximum coverage from the root after the moves are
+ * inserted.  Slower than the other engines, but it shows the answer that a live feed of segments would see.
+ * Frees moveSequence.  Returns -1 if memory runs out.
+ */
+int carTraversalDynamic( double moveSequence[], int numMoves, int numThreads ){
+    int i, max;
+    double* segmentStartArray = (double*) malloc( numMoves*sizeof( double ) );
+    double* segmentEndArray = (double*) malloc( numMoves*sizeof( double ) );
+    double* points = (double*) malloc( (numMoves+1)*sizeof( double ) );
+    DynamicSegmentTree* dst = NULL;
+
+    if( points==NULL || ( numMoves > 0 && ( segmentStartArray==NULL || segmentEndArray==NULL ) ) ){
+        max = -1;
+        goto cleanup;
+    }
+    computeSegments( moveSequence, numMoves, segmentStartArray, segmentEndArray, points );
+    int numUnique = sortUniqueDoubles( points, numMoves+1, numThreads );
+
+    dst = createDST( points, numUnique );
+    if( dst==NULL ){
+        max = -1;
+        goto cleanup;
+    }
+    for( i=0 ; i<numMoves; i++)
+        insertDST( dst, segmentStartArray[i], segmentEndArray[i] );
+    max = getMaxCoverageDST( dst );
+
+cleanup:
+    freeDST( dst );
+    free( points );
+    free( segmentStartArray );
+    free( segmentEndArray );
+    free( moveSequence );
+
+    return max;
+}
+
+/* carTraversal
+ * input: an array of moves, its length, the engine to solve it with and the most threads it may use
+ * output: the maximum number of times any point is traversed
+ *
+ * Dispatches to the requested CTP engine.  Large routes are sorted and inserted with numThreads threads, and a
+ * numThreads of 1 keeps the whole solve on the calling thread.  Frees moveSequence.  Returns -1 if memory runs out.
+ */
+int carTraversal( double moveSequence[], int numMoves, ctpEngine engine, int numThreads ){
+    if( engine == SWEEP_ENGINE )
+        return carTraversalSweep( moveSequence, numMoves, numThreads );
+    if( engine == DYNAMIC_ENGINE )
+        return carTraversalDynamic( moveSequence, numMoves, numThreads );
+    return carTraversalTree( moveSequence, numMoves, numThreads );
+}
+
+/* getEngineName
+ * input: a ctpEngine
+ * output: a string
+ *
+ * Returns the name used for the engine on the command line
+ */
+const char* getEngineName( ctpEngine engine ){
+    if( engine == SWEEP_ENGINE )
+        return "sweep";
+    if( engine == DYNAMIC_ENGINE )
+        return "dynamic";
+    return "tree";
+}
+
+/* parseEngineName
+ * input: a string and a pointer to a ctpEngine
+ * output: a boolean
+ *
+ * Stores the engine with the given command line name and returns TRUE, or returns FALSE if there is none
+ */
+bool parseEngineName( const char* name, ctpEngine* engine ){
+    int e;
+    for( e=0; e<NUM_ENGINES; e++ ){
+        if( strcmp( name, getEngineName( (ctpEngine)e ) )==0 ){
+            *engine = (ctpEngine)e;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* computeSegments
+ * input: an array of moves, its length, arrays for the segment starts and ends, and an optional array for the points
+ * output: none
+ *
+ * Follows the moves from 0 and stores each move as a segment with start <= end (unless the segment arrays are
+ * NULL).  If points is not NULL it receives the numMoves+1 positions visited (unsorted, including the starting
+ * position 0).
+ */
+void computeSegments( double moveSequence[], int numMoves, double* segmentStartArray, double* segmentEndArray, double* points ){
+    double current = 0, next = 0;
+    int i;
+
+    if( points!=NULL )
+        points[0] = 0;
+    for( i=0 ; i<numMoves; i++)
+    {
+        current = next;
+        next = next + moveSequence[i];
+
+        if( segmentStartArray!=NULL ){
+            if( current < next ){
+                segmentStartArray[i] = current;
+                segmentEndArray[i] = next;
+            }
+            else{
+                segmentStartArray[i] = next;
+                segmentEndArray[i] = current;
+            }
+        }
+        if( points!=NULL )
+            points[i+1] = next;
+    }
+}
+
+int removeDuplicates( double* points, int oldSize ){
+    int i, j = 0;
+
+    for( i=1 ; i<oldSize; i++)
+    {
+        if(points[j]==points[i])
+            continue;
+        j++;
+        points[j]=points[i];
+    }
+
+    return j+1;
+}
+
+int cmpDoubles (const void * a, const void * b) {
+    if( *(double*)a - *(double*)b == 0 )
+        return 0;
+    else if ( *(double*)a - *(double*)b > 0 )
+        return 1;
+    else
+        return -1;
+}
@@ -0,0 +1,35 @@
+#ifndef _ctp_h
+#define _ctp_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "tree.h"
+
+/* Algorithms that can solve the car traversal problem (CTP) */
+typedef enum ctpEngine{ TREE_ENGINE, SWEEP_ENGINE, DYNAMIC_ENGINE, NUM_ENGINES } ctpEngine;
+
+/* Engine used when many files are evaluated, the sweep avoids building a tree altogether */
+#define CTP_FASTEST_ENGINE SWEEP_ENGINE
+
+/* Routes with at least this many moves are inserted into the segment tree by several threads */
+#define CTP_PARALLEL_INSERT_THRESHOLD (1<<20)
+
+/**********  Functions for reading CTP files **********/
+void readArray( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves );
+
+/**********  Functions for solving the CTP **********/
+int carTraversal( double moveSequence[], int numMoves, ctpEngine engine, int numThreads );
+int carTraversalTree( double moveSequence[], int numMoves, int numThreads );
+int carTraversalSweep( double moveSequence[], int numMoves, int numThreads );
+int carTraversalDynamic( double moveSequence[], int numMoves, int numThreads );
+const char* getEngineName( ctpEngine engine );
+bool parseEngineName( const char* name, ctpEngine* engine );
+
+/**********  Helper functions for the CTP **********/
+void computeSegments( double moveSequence[], int numMoves, double* segmentStartArray, double* segmentEndArray, double* points );
+int removeDuplicates( double* points, int oldSize );
+int cmpDoubles (const void * a, const void * b);
+
+#endif
@@ -1,4 +1,5 @@
 #include "data.h"
+#include "instrument.h"
 
 /* compare
  * input: two Data* variables
@@ -7,6 +8,7 @@
  * Uses strcmp to compare the key values of the the Data* variables
  */
 int compareData( Data* d1, Data* d2 ){
+    COUNT( CNT_COMPARE_DATA );
     return strcmp( d1->key, d2->key );
 }
 
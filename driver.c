@@ -2,14 +2,27 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
-#include <time.h>
 
 #include "data.h"
 #include "tree.h"
 #include "priorityQueue.h"
+#include "huffman.h"
+#include "ctp.h"
+#include "loader.h"
+#include "stream.h"
+#include "batch.h"
+#include "radixSort.h"
+#include "instrument.h"
 
 #define MAX_VALUE 1000
 
+/* Routes with more moves than this skip the pointer-based segment tree check, which needs a node per point */
+#define STAB_CHECK_MAX_MOVES (1<<20)
+
+/**********  Functions for reporting instrumentation counters **********/
+void beginPhase( CounterSnapshot* start );
+void endPhase( const char* phase, CounterSnapshot* start );
+
 /**********  Functions for testing Huffman Tree **********/
 void testHuffmanEncoding( char *str );
 
@@ -18,14 +31,54 @@ void testAVLTree( );
 void createName( int key, char arr[] );
 
 /**********  Functions for testing Segment Tree **********/
-void testSegmentTree( char *fileName );
-int carTraversalTree( double moveSequence[], int numMoves );
-void readArray( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves );
-int removeDuplicates( double* points, int oldSize );
-int cmpDoubles (const void * a, const void * b);
+void testSegmentTree( char *fileName, ctpEngine engine );
+bool checkEngines( char *fileName );
+bool checkStabQueries( double moveSequence[], int numMoves, int* pmax );
+bool convertToBinary( char *inFileName, char *outFileName );
+bool testStream( char *fileName, size_t memoryBudget );
+
+/**********  Functions for evaluating many CTP files **********/
+bool testBatch( char *path, int numThreads, char *outFileName, ctpEngine engine );
 
 int main( int argc, char *argv[] )
 {
+    int i;
+    bool matched = true;
+    ctpEngine engine;
+
+    /* "tree FILE", "sweep FILE" or "dynamic FILE" solves one CTP file with the chosen engine */
+    if( argc == 3 && parseEngineName( argv[1], &engine ) ){
+        testSegmentTree( argv[2], engine );
+        return 0;
+    }
+
+    /* "stream FILE [budgetMB]" solves a CTP file out of core within a memory budget */
+    if( ( argc == 3 || argc == 4 ) && strcmp( argv[1], "stream" )==0 )
+        return testStream( argv[2], argc == 4 ? (size_t)atol( argv[3] ) << 20 : STREAM_DEFAULT_BUDGET ) ? 0 : 1;
+
+    /* "convert IN OUT" rewrites a CTP file in the binary format */
+    if( argc == 4 && strcmp( argv[1], "convert" )==0 )
+        return convertToBinary( argv[2], argv[3] ) ? 0 : 1;
+
+    /* "batch PATH [threads] [OUT] [engine]" solves every file of a directory or list file and writes a CSV
+     * (or, for an OUT ending in .json, a JSON) summary.  The engine defaults to CTP_FASTEST_ENGINE. */
+    if( argc >= 3 && argc <= 6 && strcmp( argv[1], "batch" )==0 ){
+        engine = CTP_FASTEST_ENGINE;
+        if( argc == 6 && !parseEngineName( argv[5], &engine ) ){
+            fprintf( stderr, "Unknown engine %s\n", argv[5] );
+            return 1;
+        }
+        return testBatch( argv[2], argc >= 4 ? atoi( argv[3] ) : getNumCPUs( ), argc >= 5 ? argv[4] : NULL, engine ) ? 0 : 1;
+    }
+
+    /* "check FILE..." cross-checks the engines against each other and the pointer-based segment tree's batch
+     * stabbing query against one lineStabQuery per point */
+    if( argc >= 3 && strcmp( argv[1], "check" )==0 ){
+        for( i=2; i<argc; i++ )
+            matched = checkEngines( argv[i] ) && matched;
+        return matched ? 0 : 1;
+    }
+
     /* test the Huffman-Encoding */
     printf("HUFFMAN TREE TEST:\n");
     testHuffmanEncoding( "aabacccadadadadda" );
@@ -36,12 +89,36 @@ int main( int argc, char *argv[] )
 
     /* test the Segment tree */
     printf("SEGMENT TREE TEST:\n");
-    testSegmentTree( "CTP-Simple01.txt" );
+    testSegmentTree( "CTP-Simple01.txt", TREE_ENGINE );
 
     return 0;
 }
 
 
+/**********  Functions for reporting instrumentation counters **********/
+
+/* beginPhase and endPhase
+ * input: a snapshot to hold the counters at the start of the phase (and the name of the phase)
+ * output: none
+ *
+ * Bracket a phase of the driver.  When it is built with INSTRUMENT, endPhase prints the counts of everything
+ * that ran since the matching beginPhase; otherwise both do nothing.
+ */
+void beginPhase( CounterSnapshot* start ){
+    if( INSTRUMENT_ENABLED )
+        snapshotCounters( start );
+}
+
+void endPhase( const char* phase, CounterSnapshot* start ){
+    CounterSnapshot now;
+    if( !INSTRUMENT_ENABLED )
+        return;
+    snapshotCounters( &now );
+    diffCounters( &now, start, &now );
+    printCounters( stdout, phase, &now );
+}
+
+
 /**********  Functions for testing Huffman Encoding **********/
 
 /* testHuffmanEncoding
@@ -51,75 +128,35 @@ int main( int argc, char *argv[] )
  * Prints Huffman encoding for each char in the original string
  */
 void testHuffmanEncoding( char *str ){
-    int i, charCounts[26], length = strlen(str);
-    bool flag = false;
-    TNode* root;
+    int i, charCounts[HUFFMAN_ALPHABET];
     Tree* pt;
-    PriorityQueue* ppq = createPQ();
+    MemStats mem;
+    CounterSnapshot phase;
 
     /* Compute frequency (i.e. # instances) of each lowercase character */
-    for( i=0; i<26; i++ )
-        charCounts[i]=0;
-
-    for( i=0; i<length; i++ ){
-        if( 'a' <= str[i] && str[i] <= 'z' ){
-            charCounts[ str[i]-'a' ]++;
-            flag = true;
-        }
-    }
-
-    if( !flag ){
+    if( !countHuffmanChars( str, strlen(str), charCounts ) ){
         printf("No lowercase characters in \"%s\"!\n", str);
         return;
     }
 
-    /* enter all of the frequencies into the priority queue */
-    for( i=0; i<26; i++ ){
-        if( charCounts[i]>0 ){
-            root = (TNode*)malloc( sizeof(TNode) );
-            attachLeafNodes( root );
-
-            root->str = (char*)malloc( (length+1)*sizeof(char) );
-            root->priority = charCounts[i];
-            root->str[0] = 'a'+i;
-            root->str[1] = '\0';
-            insertPQ( ppq, root );
-        }
-    }
-
     /* Build Huffman encoding tree */
-    TNode *min1 = removePQ( ppq );
-    while( !isEmptyPQ(ppq) ){
-        TNode* min2 = removePQ( ppq );
-
-        root = (TNode*)malloc( sizeof(TNode) );
-        root->str = (char*)malloc( (length+1)*sizeof(char) );
-        root->priority = min1->priority + min2->priority;
-        root->str[0] = '\0';
-        root->leaf = false;
-        strcat( root->str, min1->str );
-        strcat( root->str, min2->str );
-        attachChildNodes( root, min1, min2 );
-        insertPQ( ppq, root );
-
-        min1 = removePQ( ppq );
-    }
-    root = min1;
+    beginPhase( &phase );
+    pt = buildHuffmanTree( charCounts, NULL );
+    endPhase( "Huffman build", &phase );
+    getTreeMemStats( pt, &mem );
+    printMemStats( stdout, "Huffman tree", &mem );
 
     /* get the encoding for each char in the tree */
-    for( i=0; i<26; i++ ){
+    for( i=0; i<HUFFMAN_ALPHABET; i++ ){
         if( charCounts[i]>0 ){
             printf("The character '%c' is encoded as ", 'a'+i );
-            printHuffmanEncoding( root, 'a'+i );
+            printHuffmanEncoding( pt->root, 'a'+i );
             printf("\n");
         }
     }
     printf("\n");
 
-    pt = createTreeFromTNode( root );
-    pt->type = HUFFMAN;
     freeTree( pt );
-    freePQ( ppq );
 }
 
 
@@ -127,15 +164,18 @@ void testHuffmanEncoding( char *str ){
 
 void testAVLTree( ){
     int i = 0;
-    char testData[30];
+    char testData[31];
     Data *temp;
-    clock_t start, end;
+    double start, end;
+    CounterSnapshot phase;
+    MemStats mem;
 
     Tree* pt = createTree();
     pt->type = AVL;
 
     /* Time the insert function */
-    start = clock();
+    beginPhase( &phase );
+    start = getWallTime();
     for( i=1; i<MAX_VALUE; i++){
         temp = (Data *)malloc( sizeof(Data) );
         temp->verification = i;
@@ -144,12 +184,14 @@ void testAVLTree( ){
         insertTreeBalanced( pt, temp );
         // checkAVLTree( pt->root );
     }
-    end = clock();
-    printf( "Time to insert (in seconds): %lf\n" , (double)(end - start) / CLOCKS_PER_SEC );
+    end = getWallTime();
+    printf( "Time to insert (in seconds): %lf\n" , end - start );
+    endPhase( "AVL insert", &phase );
     // printTree( pt->root );
 
     /* Time the remove function */
-    start = clock();
+    beginPhase( &phase );
+    start = getWallTime();
     for( i=MAX_VALUE-1; i>0; i--){
         createName( i, testData );
 
@@ -173,8 +215,11 @@ void testAVLTree( ){
         }
         // checkAVLTree( pt->root );
     }
-    end = clock();
-    printf( "Time to remove (in seconds): %lf\n" , (double)(end - start) / CLOCKS_PER_SEC );
+    end = getWallTime();
+    printf( "Time to remove (in seconds): %lf\n" , end - start );
+    endPhase( "AVL remove", &phase );
+    getTreeMemStats( pt, &mem );
+    printMemStats( stdout, "AVL tree", &mem );
     // printTree( pt->root );
 
     /* Free all data in pt */
@@ -201,15 +246,19 @@ void createName( int freq, char *keyName ){
 
 /**********  Functions for testing Segment Tree **********/
 
-void testSegmentTree( char *fileName ){
+void testSegmentTree( char *fileName, ctpEngine engine ){
     double *moveSequence;
     int providedSolution, computedSolution;
     int numMoves;
+    CounterSnapshot phase;
 
-    readArray( fileName, &moveSequence, &providedSolution, &numMoves );
-    computedSolution = carTraversalTree( moveSequence, numMoves );
+    if( !loadMoves( fileName, &moveSequence, &providedSolution, &numMoves, getNumCPUs( ) ) )
+        return;
+    beginPhase( &phase );
+    computedSolution = carTraversal( moveSequence, numMoves, engine, getNumCPUs( ) );
+    endPhase( getEngineName( engine ), &phase );
 
-    printf( "Your segment tree computed a solution of %d\n", computedSolution );
+    printf( "Your %s engine computed a solution of %d\n", getEngineName( engine ), computedSolution );
     if( providedSolution!=-1 && computedSolution==providedSolution ){
         printf( "Your algorithm worked correctly (i.e. same as provided solution)\n" );
     }
@@ -218,126 +267,198 @@ void testSegmentTree( char *fileName ){
     }
 }
 
-void readArray( char *fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves ){
-    double* moveSequence;
-
-    *pnumMoves = 0;
-    *pprovidedSolution = -1;
+/* checkEngines
+ * input: a CTP file name
+ * output: a boolean
+ *
+ * Solves the file with every engine, prints the answers and timings, and returns TRUE if they all agree
+ * with each other and with the provided solution (if there is one).  Routes of at most STAB_CHECK_MAX_MOVES moves
+ * are also solved with the pointer-based segment tree, whose batchStabQuery must match lineStabQuery at every point.
+ */
+bool checkEngines( char *fileName ){
+    double *moveSequence, *copy;
+    int providedSolution, numMoves, e, solutions[NUM_ENGINES], stabMax;
+    bool matched = true;
+    double start;
+    CounterSnapshot before, after, counts[NUM_ENGINES];
+
+    if( !loadMoves( fileName, &moveSequence, &providedSolution, &numMoves, getNumCPUs( ) ) )
+        return false;
+
+    printf( "%s:", fileName );
+    for( e=0; e<NUM_ENGINES; e++ ){
+        copy = (double*) malloc( (numMoves > 0 ? numMoves : 1)*sizeof( double ) );
+        memcpy( copy, moveSequence, numMoves*sizeof( double ) );
+
+        snapshotCounters( &before );
+        start = getWallTime();
+        solutions[e] = carTraversal( copy, numMoves, (ctpEngine)e, getNumCPUs( ) );
+        snapshotCounters( &after );
+        diffCounters( &after, &before, &counts[e] );
+        printf( " %s %d (%lf s),", getEngineName( (ctpEngine)e ), solutions[e], getWallTime() - start );
+
+        if( solutions[e]!=solutions[0] || ( providedSolution!=-1 && solutions[e]!=providedSolution ) )
+            matched = false;
+    }
+    if( numMoves <= STAB_CHECK_MAX_MOVES ){
+        if( !checkStabQueries( moveSequence, numMoves, &stabMax ) || stabMax!=solutions[0] )
+            matched = false;
+        printf( " pointer %d,", stabMax );
+    }
+    printf( " provided %d\n", providedSolution );
+    for( e=0; e<NUM_ENGINES && INSTRUMENT_ENABLED; e++ )
+        printCounters( stdout, getEngineName( (ctpEngine)e ), &counts[e] );
+    free( moveSequence );
 
-    int i;
+    if( !matched )
+        printf( "MISMATCH in %s\n", fileName );
+    return matched;
+}
 
-    if( fileName != NULL ){
-        FILE *in_file = fopen(fileName, "r");
+/* checkStabQueries
+ * input: an array of moves, its length, and a pointer to store the largest count in
+ * output: a boolean
+ *
+ * Inserts every move into a pointer-based segment tree built with constructSegmentTree and answers a stabbing
+ * query at every unique point twice, once with batchStabQuery and once with lineStabQuery per point.  Returns
+ * TRUE if the two agree everywhere.  moveSequence is left untouched.
+ */
+bool checkStabQueries( double moveSequence[], int numMoves, int* pmax ){
+    double *starts = (double*) malloc( (numMoves > 0 ? numMoves : 1)*sizeof( double ) );
+    double *ends = (double*) malloc( (numMoves > 0 ? numMoves : 1)*sizeof( double ) );
+    double *points = (double*) malloc( (numMoves+1)*sizeof( double ) );
+    int *counts = (int*) malloc( (numMoves+1)*sizeof( int ) );
+    int i, numUnique;
+    bool matched = true;
+    Tree *t;
+
+    if( starts==NULL || ends==NULL || points==NULL || counts==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    computeSegments( moveSequence, numMoves, starts, ends, points );
+    numUnique = sortUniqueDoubles( points, numMoves+1, getNumCPUs( ) );
+
+    t = createTree( );
+    t->type = SEGMENT;
+    freeTNode( t, t->root );
+    t->root = constructSegmentTree( t, points, 0, numUnique-1 );
+    for( i=0; i<numMoves; i++ )
+        insertSegment( t->root, starts[i], ends[i] );
+
+    *pmax = batchStabQuery( t->root, points, numUnique, counts );
+    for( i=0; i<numUnique; i++ ){
+        if( counts[i]!=lineStabQuery( t->root, points[i] ) )
+            matched = false;
+    }
 
-        if(in_file == NULL)
-        {
-            printf("File %s not found.\n", fileName);
-            exit(-1);
-        }
+    freeTree( t );
+    free( counts );
+    free( points );
+    free( ends );
+    free( starts );
+    return matched;
+}
 
-        /* read the number of nodes from file and allocate space to store them */
-        if( fscanf( in_file, "%d%d", pnumMoves, pprovidedSolution ) != 2 )
-        {
-            printf( "Invalid file format.  First line should be number of moves followed by the correct solution (or -1 if none is provided)\n");
-            exit(-1);
-        }
-        if( *pnumMoves < 0 )
-        {
-            printf( "The number moves must be non-negative.\n");
-            exit(-1);
-        }
+/* convertToBinary
+ * input: the name of a CTP file and the name of the binary file to create
+ * output: a boolean
+ *
+ * Loads a CTP file in either format and saves it in the binary format
+ */
+bool convertToBinary( char *inFileName, char *outFileName ){
+    double *moveSequence;
+    int providedSolution, numMoves;
+    bool ok;
 
-        (*pmoveSequence) = (double*) malloc( (*pnumMoves)*sizeof( double ) );
-        moveSequence = (*pmoveSequence);
-        /* read in names of nodes */
-        for( i=0 ; i<(*pnumMoves); i++)
-        {
-            if( fscanf( in_file, "%lf", &moveSequence[i] ) == 0 )
-            {
-                printf( "Failed to read %dth double in the move sequence", i );
-                exit(-1);
-            }
-        }
-        fclose( in_file );
-    }
+    if( !loadMoves( inFileName, &moveSequence, &providedSolution, &numMoves, getNumCPUs( ) ) )
+        return false;
+    ok = saveMovesBinary( outFileName, moveSequence, providedSolution, numMoves );
+    free( moveSequence );
+    return ok;
 }
 
-int carTraversalTree( double moveSequence[], int numMoves ){
-    double current = 0, next = 0;
-    int i, max;
-    double* segmentStartArray = (double*) malloc( numMoves*sizeof( double ) );
-    double* segmentEndArray = (double*) malloc( numMoves*sizeof( double ) );
-    double* points = (double*) malloc( (numMoves+1)*sizeof( double ) );
-    Tree* pt;
-    TNode* root;
+/* testStream
+ * input: a CTP file name and a memory budget in bytes
+ * output: a boolean
+ *
+ * Solves the file with carTraversalStream and compares against the provided solution
+ */
+bool testStream( char *fileName, size_t memoryBudget ){
+    int providedSolution, computedSolution;
 
-    points[0] = 0;
-    for( i=0 ; i<numMoves; i++)
-    {
-        current = next;
-        next = next + moveSequence[i];
+    if( !carTraversalStream( fileName, memoryBudget, &computedSolution, &providedSolution ) )
+        return false;
 
-        if( current < next ){
-            segmentStartArray[i] = current;
-            segmentEndArray[i] = next;
-        }
-        else{
-            segmentStartArray[i] = next;
-            segmentEndArray[i] = current;
-        }
-        points[i+1] = next;
+    printf( "Your stream engine computed a solution of %d\n", computedSolution );
+    if( providedSolution!=-1 && computedSolution==providedSolution ){
+        printf( "Your algorithm worked correctly (i.e. same as provided solution)\n" );
     }
-
-    /* Sort the points and remove all duplicates */
-    qsort( points, numMoves+1, sizeof(double), cmpDoubles );
-    int numUnique = removeDuplicates( points, numMoves+1 );
-
-    /* build the segment tree */
-    root = constructSegmentTree( points, 0, numUnique-1 );
-    for( i=0 ; i<numMoves; i++)
-        insertSegment( root, segmentStartArray[i], segmentEndArray[i] );
-
-    /* query the segment tree */
-    max = -1;
-    for( i=0 ; i<numUnique; i++)
-    {
-        int temp = lineStabQuery( root, points[i] );
-        if( temp>max ){
-            max = temp;
-        }
+    else if( providedSolution!=-1){
+        printf( "Your algorithm did not match the provided solution of %d.\n", providedSolution );
+        return false;
     }
-
-    //Free all of the nodes in our tree
-    pt = createTreeFromTNode( root );
-    pt->type = SEGMENT;
-    freeTree( pt );
-    free( points );
-    free( segmentStartArray );
-    free( segmentEndArray );
-    free( moveSequence );
-
-    return max;
+    return true;
 }
 
-int removeDuplicates( double* points, int oldSize ){
-    int i, j = 0;
 
-    for( i=1 ; i<oldSize; i++)
-    {
-        if(points[j]==points[i])
-            continue;
-        j++;
-        points[j]=points[i];
+/**********  Functions for evaluating many CTP files **********/
+
+/* testBatch
+ * input: a directory or list file, a thread count, a summary file name (or NULL for stdout) and an engine
+ * output: a boolean
+ *
+ * Solves every listed CTP file on a thread pool and writes a per-file summary, followed by a short total on
+ * stderr.  Returns FALSE if any file fails to load, fails to solve or disagrees with its provided solution.
+ */
+bool testBatch( char *path, int numThreads, char *outFileName, ctpEngine engine ){
+    char **fileNames;
+    int i, numFiles, numFailed = 0;
+    size_t length;
+    BatchResult *results;
+    FILE *out = stdout;
+    double start, end;
+    CounterSnapshot phase;
+
+    if( !collectBatchFiles( path, &fileNames, &numFiles ) )
+        return false;
+    results = (BatchResult*)malloc( ( numFiles > 0 ? numFiles : 1 )*sizeof(BatchResult) );
+    if( results == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        freeBatchFiles( fileNames, numFiles );
+        return false;
     }
 
-    return j+1;
-}
+    beginPhase( &phase );
+    start = getWallTime( );
+    if( !runBatch( fileNames, numFiles, numThreads, engine, results ) ){
+        free( results );
+        freeBatchFiles( fileNames, numFiles );
+        return false;
+    }
+    end = getWallTime( );
 
-int cmpDoubles (const void * a, const void * b) {
-    if( *(double*)a - *(double*)b == 0 )
-        return 0;
-    else if ( *(double*)a - *(double*)b > 0 )
-        return 1;
+    if( outFileName != NULL && ( out = fopen( outFileName, "w" ) ) == NULL ){
+        fprintf( stderr, "Cannot create %s.\n", outFileName );
+        out = stdout;
+    }
+    length = outFileName != NULL ? strlen( outFileName ) : 0;
+    if( length >= 5 && strcmp( outFileName + length - 5, ".json" )==0 )
+        writeBatchJSON( out, results, numFiles );
     else
-        return -1;
+        writeBatchCSV( out, results, numFiles );
+    if( out != stdout )
+        fclose( out );
+
+    for( i=0; i<numFiles; i++ ){
+        if( results[i].status != BATCH_OK && results[i].status != BATCH_UNCHECKED )
+            numFailed++;
+    }
+    fprintf( stderr, "%d files solved with the %s engine in %.3f seconds, %d failed\n", numFiles, getEngineName( engine ),
+             end - start, numFailed );
+    endPhase( "batch", &phase );
+
+    free( results );
+    freeBatchFiles( fileNames, numFiles );
+    return numFailed == 0;
 }
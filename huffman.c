@@ -0,0 +1,172 @@
+#include "huffman.h"
+
+/**********  Functions for building Huffman trees **********/
+
+/* countHuffmanChars
+ * input: a string, its length, and an array to store the count of each lowercase character in
+ * output: a boolean
+ *
+ * Computes the frequency (i.e. # instances) of each lowercase character.  Returns FALSE if there are none.
+ */
+bool countHuffmanChars( const char* str, long length, int charCounts[HUFFMAN_ALPHABET] ){
+    long i;
+    bool flag = false;
+
+    for( i=0; i<HUFFMAN_ALPHABET; i++ )
+        charCounts[i]=0;
+
+    for( i=0; i<length; i++ ){
+        if( 'a' <= str[i] && str[i] <= 'z' ){
+            charCounts[ str[i]-'a' ]++;
+            flag = true;
+        }
+    }
+    return flag;
+}
+
+/* buildHuffmanTree
+ * input: the count of each lowercase character, the Allocator to take the tree's memory from (NULL for malloc/free)
+ * output: a Huffman tree (free it with freeTree), or NULL if every count is 0
+ *
+ * Repeatedly merges the two least frequent subtrees taken from a priority queue.  Each node's str holds the
+ * characters below it.
+ */
+Tree* buildHuffmanTree( int charCounts[HUFFMAN_ALPHABET], Allocator* allocator ){
+    int i;
+    TNode *root, *min1, *min2;
+    Tree* pt = createTreeWithAllocator( allocator );
+    PriorityQueue* ppq = createPQWithAllocator( allocator );
+
+    pt->type = HUFFMAN;
+
+    /* enter all of the frequencies into the priority queue */
+    for( i=0; i<HUFFMAN_ALPHABET; i++ ){
+        if( charCounts[i]>0 ){
+            root = createTNode( pt );
+            attachLeafNodes( pt, root );
+
+            root->str = (char*)trackedAlloc( &pt->mem, 2*sizeof(char) );
+            if( root->str == NULL ){
+                fprintf( stderr, "malloc failed\n" );
+                exit(-1);
+            }
+            root->priority = charCounts[i];
+            root->str[0] = 'a'+i;
+            root->str[1] = '\0';
+            insertPQ( ppq, root );
+        }
+    }
+    if( isEmptyPQ( ppq ) ){
+        freePQ( ppq );
+        freeTree( pt );
+        return NULL;
+    }
+
+    /* Build Huffman encoding tree */
+    min1 = removePQ( ppq );
+    while( !isEmptyPQ(ppq) ){
+        min2 = removePQ( ppq );
+
+        root = createTNode( pt );
+        root->str = (char*)trackedAlloc( &pt->mem, (strlen(min1->str) + strlen(min2->str) + 1)*sizeof(char) );
+        if( root->str == NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+        root->priority = min1->priority + min2->priority;
+        root->str[0] = '\0';
+        root->leaf = false;
+        strcat( root->str, min1->str );
+        strcat( root->str, min2->str );
+        attachChildNodes( root, min1, min2 );
+        insertPQ( ppq, root );
+
+        min1 = removePQ( ppq );
+    }
+
+    freePQ( ppq );
+
+    /* replace the empty tree's leaf root with the finished tree */
+    freeTNode( pt, pt->root );
+    pt->root = min1;
+    min1->pParent = NULL;
+    return pt;
+}
+
+
+/**********  Functions for encoding and decoding with Huffman trees **********/
+
+/* getHuffmanCodes
+ * input: the root of a Huffman tree, the counts it was built from, and arrays to store each character's code
+ *        and code length in
+ * output: none
+ *
+ * Turns the encoding of every character in the tree into a bit pattern, first bit in the lowest position.
+ * Characters that are not in the tree get length 0.  A tree of a single character has an empty encoding, so that
+ * character gets the 1-bit code 0 and every occurrence still costs a bit.
+ */
+void getHuffmanCodes( TNode* root, int charCounts[HUFFMAN_ALPHABET], unsigned int codes[HUFFMAN_ALPHABET], int lengths[HUFFMAN_ALPHABET] ){
+    int i, j;
+    char encoding[HUFFMAN_ALPHABET+1];
+
+    for( i=0; i<HUFFMAN_ALPHABET; i++ ){
+        codes[i] = 0;
+        lengths[i] = 0;
+        if( charCounts[i]>0 ){
+            lengths[i] = getHuffmanEncoding( root, 'a'+i, encoding );
+            for( j=0; j<lengths[i]; j++ )
+                if( encoding[j] == '1' )
+                    codes[i] |= 1u << j;
+            if( lengths[i] == 0 )
+                lengths[i] = 1;
+        }
+    }
+}
+
+/* encodeHuffman
+ * input: a string, its length, the codes and code lengths from getHuffmanCodes, and a zeroed output buffer of at
+ *        least (length*(HUFFMAN_ALPHABET-1)+7)/8 bytes
+ * output: the number of bits written
+ *
+ * Packs the code of every lowercase character of the string into out, first bit in the lowest position of each byte
+ */
+long encodeHuffman( const char* str, long length, unsigned int codes[HUFFMAN_ALPHABET], int lengths[HUFFMAN_ALPHABET], unsigned char* out ){
+    long i, bits = 0;
+    int c, j;
+
+    for( i=0; i<length; i++ ){
+        if( str[i] < 'a' || str[i] > 'z' )
+            continue;
+        c = str[i] - 'a';
+        for( j=0; j<lengths[c]; j++, bits++ )
+            if( codes[c] >> j & 1 )
+                out[bits >> 3] |= 1 << (bits & 7);
+    }
+    return bits;
+}
+
+/* decodeHuffman
+ * input: the root of the Huffman tree the data was encoded with, the output of encodeHuffman, the number of
+ *        characters it holds, and a buffer of at least numChars chars to store them in
+ * output: the number of bits read
+ *
+ * Walks the tree one bit at a time, going left on 0 and right on 1, and outputs a character every time it reaches
+ * a node whose children are empty leaves.  A tree of a single character has the 1-bit code 0 (see
+ * getHuffmanCodes), so each of its characters skips one bit.
+ */
+long decodeHuffman( TNode* root, const unsigned char* in, long numChars, char* out ){
+    long i, bits = 0;
+    TNode* node;
+
+    for( i=0; i<numChars; i++ ){
+        node = root;
+        if( node->pLeft->leaf )
+            bits++;
+        while( !node->pLeft->leaf ){
+            node = ( in[bits >> 3] >> (bits & 7) & 1 ) ? node->pRight : node->pLeft;
+            bits++;
+        }
+        out[i] = node->str[0];
+    }
+    return bits;
+}
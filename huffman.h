@@ -0,0 +1,23 @@
+#ifndef _huffman_h
+#define _huffman_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "tree.h"
+#include "priorityQueue.h"
+
+/* Huffman trees encode the lowercase letters 'a' to 'z' */
+#define HUFFMAN_ALPHABET 26
+
+/**********  Functions for building Huffman trees **********/
+bool countHuffmanChars( const char* str, long length, int charCounts[HUFFMAN_ALPHABET] );
+Tree* buildHuffmanTree( int charCounts[HUFFMAN_ALPHABET], Allocator* allocator );
+
+/**********  Functions for encoding and decoding with Huffman trees **********/
+void getHuffmanCodes( TNode* root, int charCounts[HUFFMAN_ALPHABET], unsigned int codes[HUFFMAN_ALPHABET], int lengths[HUFFMAN_ALPHABET] );
+long encodeHuffman( const char* str, long length, unsigned int codes[HUFFMAN_ALPHABET], int lengths[HUFFMAN_ALPHABET], unsigned char* out );
+long decodeHuffman( TNode* root, const unsigned char* in, long numChars, char* out );
+
+#endif
@@ -0,0 +1,108 @@
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "instrument.h"
+
+/*
+ * Counts of the calling thread, and the counts that finished threads flushed into the process-wide totals
+ */
+__thread unsigned long long threadCounters[NUM_COUNTERS];
+static unsigned long long flushedCounters[NUM_COUNTERS];
+static pthread_mutex_t flushLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* snapshotCounters
+ * input: a pointer to a CounterSnapshot
+ * output: none
+ *
+ * Stores the flushed totals plus the calling thread's own counts.  Worker threads must call FLUSH_COUNTERS
+ * before they exit for their counts to show up here.
+ */
+void snapshotCounters( CounterSnapshot* s ){
+    int i;
+    pthread_mutex_lock( &flushLock );
+    for( i=0; i<NUM_COUNTERS; i++ )
+        s->counts[i] = flushedCounters[i] + threadCounters[i];
+    pthread_mutex_unlock( &flushLock );
+}
+
+/* resetCounters
+ * input: none
+ * output: none
+ *
+ * Zeroes the flushed totals and the calling thread's counts
+ */
+void resetCounters( ){
+    pthread_mutex_lock( &flushLock );
+    memset( flushedCounters, 0, sizeof(flushedCounters) );
+    memset( threadCounters, 0, sizeof(threadCounters) );
+    pthread_mutex_unlock( &flushLock );
+}
+
+/* flushThreadCounters
+ * input: none
+ * output: none
+ *
+ * Moves the calling thread's counts into the process-wide totals
+ */
+void flushThreadCounters( ){
+    int i;
+    pthread_mutex_lock( &flushLock );
+    for( i=0; i<NUM_COUNTERS; i++ ){
+        flushedCounters[i] += threadCounters[i];
+        threadCounters[i] = 0;
+    }
+    pthread_mutex_unlock( &flushLock );
+}
+
+/* diffCounters
+ * input: two snapshots and a snapshot to store their difference in
+ * output: none
+ *
+ * out = later - earlier, the counts of whatever ran between the two snapshots
+ */
+void diffCounters( CounterSnapshot* later, CounterSnapshot* earlier, CounterSnapshot* out ){
+    int i;
+    for( i=0; i<NUM_COUNTERS; i++ )
+        out->counts[i] = later->counts[i] - earlier->counts[i];
+}
+
+/* printCounters
+ * input: an output file, the name of a phase, and its counts
+ * output: none
+ *
+ * Prints the phase's counts on one line
+ */
+void printCounters( FILE* out, const char* phase, CounterSnapshot* s ){
+    int i;
+    fprintf( out, "Counters for %s:", phase );
+    for( i=0; i<NUM_COUNTERS; i++ )
+        fprintf( out, " %s=%llu", getCounterName( (counterId)i ), s->counts[i] );
+    fprintf( out, "\n" );
+}
+
+/* getCounterName
+ * input: a counterId
+ * output: a string
+ *
+ * Returns the name used for the counter in reports
+ */
+const char* getCounterName( counterId id ){
+    static const char* names[NUM_COUNTERS] = { "compare_data", "right_rotate", "left_rotate", "height_update_steps",
+                                               "leaf_allocations", "pq_sift_steps", "segment_nodes_visited" };
+    return names[id];
+}
+
+/**********  Functions for timing **********/
+
+/* getWallTime
+ * input: none
+ * output: a double
+ *
+ * Returns the current wall-clock time in seconds from a monotonic clock
+ */
+double getWallTime( ){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
@@ -0,0 +1,43 @@
+#ifndef _instrument_h
+#define _instrument_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Hot-path counters.  Build with "make INSTRUMENT=1" (after "make clean") to enable them; otherwise the
+ * COUNT macros compile to nothing and every count stays 0.
+ */
+typedef enum counterId{ CNT_COMPARE_DATA, CNT_RIGHT_ROTATE, CNT_LEFT_ROTATE, CNT_HEIGHT_UPDATES, CNT_LEAF_ALLOCS,
+                        CNT_PQ_SIFT_STEPS, CNT_SEGMENT_VISITS, NUM_COUNTERS } counterId;
+
+typedef struct CounterSnapshot
+{
+    unsigned long long counts[NUM_COUNTERS];
+} CounterSnapshot;
+
+#ifdef INSTRUMENT
+#define INSTRUMENT_ENABLED 1
+extern __thread unsigned long long threadCounters[NUM_COUNTERS];
+#define COUNT( id ) ( threadCounters[id]++ )
+#define COUNT_N( id, n ) ( threadCounters[id] += (n) )
+#define FLUSH_COUNTERS( ) flushThreadCounters( )
+#else
+#define INSTRUMENT_ENABLED 0
+#define COUNT( id ) ((void)0)
+#define COUNT_N( id, n ) ((void)0)
+#define FLUSH_COUNTERS( ) ((void)0)
+#endif
+
+/**********  Functions for reading instrumentation counters **********/
+void snapshotCounters( CounterSnapshot* s );
+void resetCounters( );
+void flushThreadCounters( );
+void diffCounters( CounterSnapshot* later, CounterSnapshot* earlier, CounterSnapshot* out );
+void printCounters( FILE* out, const char* phase, CounterSnapshot* s );
+const char* getCounterName( counterId id );
+
+/**********  Functions for timing **********/
+double getWallTime( );
+
+#endif
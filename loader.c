@@ -0,0 +1,494 @@
+#define _GNU_SOURCE     /* for strtod_l */
+#include <string.h>
+#include <stdint.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "loader.h"
+#include "radixSort.h"
+
+typedef struct ParseChunk
+{
+    const char *begin, *end;    /* text owned by this chunk, both ends fall on whitespace or the end of the file */
+    double *out;                /* destination array for the whole file */
+    int first;                  /* index in out of this chunk's first number */
+    int limit;                  /* number of moves in the file, later numbers are ignored */
+    int count;                  /* number of numbers in the chunk */
+    bool ok;                    /* false if a number failed to parse */
+    bool running;               /* a thread was created for this chunk (it ran on the calling thread otherwise) */
+} ParseChunk;
+
+void *countChunkWorker( void *arg );
+void *parseChunkWorker( void *arg );
+const char* skipSpaces( const char* p, const char* end );
+void initCLocale( );
+
+/*
+ * Powers of ten that are exactly representable as doubles
+ */
+static const double exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * The "C" locale used by parseDouble's strtod_l fallback, created once by the first thread that needs it
+ */
+static locale_t cLocale;
+static pthread_once_t cLocaleOnce = PTHREAD_ONCE_INIT;
+
+/**********  Functions for loading CTP files **********/
+
+/* loadMoves
+ * input: a file name, pointers to store the moves, the provided solution and the number of moves in, and a thread count
+ * output: a boolean
+ *
+ * Loads a CTP file in either the binary or the text format, chosen by the first bytes of the file.  Text files are
+ * parsed with up to numThreads threads.
+ * Returns FALSE (after printing why to stderr) if the file cannot be loaded; nothing is left allocated then.
+ */
+bool loadMoves( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves, int numThreads ){
+    char magic[8];
+    bool binary = false;
+    FILE* in_file = fopen( fileName, "rb" );
+
+    if( in_file == NULL ){
+        fprintf( stderr, "File %s not found.\n", fileName );
+        return false;
+    }
+    if( fread( magic, 1, sizeof(magic), in_file ) == sizeof(magic) && memcmp( magic, CTP_BINARY_MAGIC, sizeof(magic) )==0 )
+        binary = true;
+    fclose( in_file );
+
+    if( binary )
+        return loadMovesBinary( fileName, pmoveSequence, pprovidedSolution, pnumMoves );
+    return loadMovesText( fileName, pmoveSequence, pprovidedSolution, pnumMoves, numThreads );
+}
+
+/* loadMovesText
+ * input: a file name, pointers to store the moves, the provided solution and the number of moves in, and a thread count
+ * output: a boolean
+ *
+ * Maps a text CTP file into memory and parses it without stdio.  Large files are split at whitespace into
+ * chunks: every thread first counts the numbers in its chunk, then parses them straight into their final slots.
+ * A chunk whose thread cannot be created is handled by the calling thread.
+ * Returns FALSE if the header is invalid or the file holds fewer numbers than the header promises.
+ */
+bool loadMovesText( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves, int numThreads ){
+    int fd, t, total = 0;
+    struct stat sb;
+    const char *text, *p, *end;
+    long long numMoves, providedSolution;
+    ParseChunk *chunks;
+    pthread_t *threads;
+    bool ok = true;
+
+    *pmoveSequence = NULL;
+    *pnumMoves = 0;
+    *pprovidedSolution = -1;
+
+    fd = open( fileName, O_RDONLY );
+    if( fd < 0 ){
+        fprintf( stderr, "File %s not found.\n", fileName );
+        return false;
+    }
+    if( fstat( fd, &sb ) != 0 || sb.st_size == 0 ){
+        fprintf( stderr, "%s: invalid file format.\n", fileName );
+        close( fd );
+        return false;
+    }
+    text = (const char*)mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( text == MAP_FAILED ){
+        fprintf( stderr, "%s: mmap failed\n", fileName );
+        return false;
+    }
+    madvise( (void*)text, sb.st_size, MADV_SEQUENTIAL );
+    end = text + sb.st_size;
+
+    /* read the number of moves and the provided solution */
+    p = parseLong( skipSpaces( text, end ), end, &numMoves );
+    if( p != NULL )
+        p = parseLong( skipSpaces( p, end ), end, &providedSolution );
+    if( p == NULL || numMoves < 0 || numMoves > INT32_MAX ){
+        fprintf( stderr, "%s: invalid file format.  First line should be number of moves followed by the correct solution (or -1 if none is provided)\n", fileName );
+        munmap( (void*)text, sb.st_size );
+        return false;
+    }
+
+    /* split the rest of the file into chunks that end on whitespace */
+    if( numThreads < 1 || (end - p) / numThreads < LOADER_MIN_CHUNK )
+        numThreads = (end - p) / LOADER_MIN_CHUNK > 1 ? (int)((end - p) / LOADER_MIN_CHUNK) : 1;
+    chunks = (ParseChunk*)malloc( numThreads*sizeof(ParseChunk) );
+    threads = (pthread_t*)malloc( numThreads*sizeof(pthread_t) );
+    *pmoveSequence = (double*)malloc( (numMoves > 0 ? numMoves : 1)*sizeof(double) );
+    if( chunks==NULL || threads==NULL || *pmoveSequence==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        free( chunks );
+        free( threads );
+        free( *pmoveSequence );
+        *pmoveSequence = NULL;
+        munmap( (void*)text, sb.st_size );
+        return false;
+    }
+    for( t=0; t<numThreads; t++ ){
+        const char* cut = t==numThreads-1 ? end : p + (end - p)*(t+1)/numThreads;
+        chunks[t].begin = t==0 ? p : chunks[t-1].end;
+        if( cut < chunks[t].begin ) /* the previous chunk ended inside a very long token */
+            cut = chunks[t].begin;
+        while( cut < end && !isSpace( *cut ) )
+            cut++;
+        chunks[t].end = cut;
+        chunks[t].out = *pmoveSequence;
+        chunks[t].limit = (int)numMoves;
+        chunks[t].ok = true;
+    }
+
+    /* count, then parse each chunk into its slots */
+    for( t=1; t<numThreads; t++ ){
+        chunks[t].running = pthread_create( &threads[t], NULL, countChunkWorker, &chunks[t] )==0;
+        if( !chunks[t].running )
+            countChunkWorker( &chunks[t] );
+    }
+    countChunkWorker( &chunks[0] );
+    for( t=1; t<numThreads; t++ ){
+        if( chunks[t].running )
+            pthread_join( threads[t], NULL );
+    }
+    for( t=0; t<numThreads; t++ ){
+        chunks[t].first = total;
+        total += chunks[t].count;
+    }
+
+    if( total < numMoves ){
+        fprintf( stderr, "%s: failed to read %dth double in the move sequence\n", fileName, total );
+        ok = false;
+    }
+    else{
+        for( t=1; t<numThreads; t++ ){
+            chunks[t].running = pthread_create( &threads[t], NULL, parseChunkWorker, &chunks[t] )==0;
+            if( !chunks[t].running )
+                parseChunkWorker( &chunks[t] );
+        }
+        parseChunkWorker( &chunks[0] );
+        for( t=1; t<numThreads; t++ ){
+            if( chunks[t].running )
+                pthread_join( threads[t], NULL );
+        }
+        for( t=0; t<numThreads; t++ ){
+            if( !chunks[t].ok ){
+                fprintf( stderr, "%s: invalid number in the move sequence\n", fileName );
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    free( chunks );
+    free( threads );
+    munmap( (void*)text, sb.st_size );
+    if( !ok ){
+        free( *pmoveSequence );
+        *pmoveSequence = NULL;
+        return false;
+    }
+    *pnumMoves = (int)numMoves;
+    *pprovidedSolution = (int)providedSolution;
+    return true;
+}
+
+/* countChunkWorker and parseChunkWorker
+ * input: a pointer to a ParseChunk
+ * output: NULL
+ *
+ * Count the whitespace separated numbers in a chunk / parse them into out starting at index first
+ */
+void *countChunkWorker( void *arg ){
+    ParseChunk *chunk = (ParseChunk*)arg;
+    const char *p = chunk->begin;
+    bool inToken = false;
+    int count = 0;
+
+    for( ; p < chunk->end; p++ ){
+        if( isSpace( *p ) )
+            inToken = false;
+        else if( !inToken ){
+            inToken = true;
+            count++;
+        }
+    }
+    chunk->count = count;
+    return NULL;
+}
+
+void *parseChunkWorker( void *arg ){
+    ParseChunk *chunk = (ParseChunk*)arg;
+    const char *p = skipSpaces( chunk->begin, chunk->end );
+    int i;
+
+    for( i=chunk->first; i<chunk->limit && p<chunk->end; i++ ){
+        p = parseDouble( p, chunk->end, &chunk->out[i] );
+        if( p == NULL || ( p < chunk->end && !isSpace( *p ) ) ){
+            chunk->ok = false;
+            return NULL;
+        }
+        p = skipSpaces( p, chunk->end );
+    }
+    return NULL;
+}
+
+/* loadMovesBinary
+ * input: a file name and pointers to store the moves, the provided solution and the number of moves in
+ * output: a boolean
+ *
+ * Loads a binary CTP file (see CTP_BINARY_MAGIC).  On little-endian machines the moves are read straight into
+ * the array with no conversion at all.
+ */
+bool loadMovesBinary( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves ){
+    char magic[8];
+    int64_t header[2];
+    size_t i;
+    FILE* in_file = fopen( fileName, "rb" );
+
+    *pmoveSequence = NULL;
+    *pnumMoves = 0;
+    *pprovidedSolution = -1;
+    if( in_file == NULL ){
+        fprintf( stderr, "File %s not found.\n", fileName );
+        return false;
+    }
+    if( fread( magic, 1, sizeof(magic), in_file ) != sizeof(magic) || memcmp( magic, CTP_BINARY_MAGIC, sizeof(magic) )!=0 ||
+        fread( header, sizeof(int64_t), 2, in_file ) != 2 ){
+        fprintf( stderr, "%s: invalid binary CTP file.\n", fileName );
+        fclose( in_file );
+        return false;
+    }
+    if( !isLittleEndian( ) ){
+        swapBytes( &header[0], sizeof(int64_t) );
+        swapBytes( &header[1], sizeof(int64_t) );
+    }
+    if( header[0] < 0 || header[0] > INT32_MAX ){
+        fprintf( stderr, "%s: the number moves must be non-negative.\n", fileName );
+        fclose( in_file );
+        return false;
+    }
+
+    *pmoveSequence = (double*)malloc( (header[0] > 0 ? header[0] : 1)*sizeof(double) );
+    if( *pmoveSequence == NULL || fread( *pmoveSequence, sizeof(double), header[0], in_file ) != (size_t)header[0] ){
+        fprintf( stderr, "%s: failed to read the move sequence\n", fileName );
+        free( *pmoveSequence );
+        *pmoveSequence = NULL;
+        fclose( in_file );
+        return false;
+    }
+    fclose( in_file );
+
+    if( !isLittleEndian( ) )
+        for( i=0; i<(size_t)header[0]; i++ )
+            swapBytes( &(*pmoveSequence)[i], sizeof(double) );
+    *pnumMoves = (int)header[0];
+    *pprovidedSolution = (int)header[1];
+    return true;
+}
+
+/* saveMovesBinary
+ * input: a file name, an array of moves, the provided solution and the number of moves
+ * output: a boolean
+ *
+ * Writes the moves in the binary CTP format.  Returns FALSE if the file could not be written.
+ */
+bool saveMovesBinary( char* fileName, double* moveSequence, int providedSolution, int numMoves ){
+    int64_t header[2] = { numMoves, providedSolution };
+    double move;
+    bool ok;
+    int i;
+    FILE* out_file = fopen( fileName, "wb" );
+
+    if( out_file == NULL ){
+        fprintf( stderr, "Could not open %s for writing.\n", fileName );
+        return false;
+    }
+    if( !isLittleEndian( ) ){
+        swapBytes( &header[0], sizeof(int64_t) );
+        swapBytes( &header[1], sizeof(int64_t) );
+    }
+    ok = fwrite( CTP_BINARY_MAGIC, 1, 8, out_file ) == 8 && fwrite( header, sizeof(int64_t), 2, out_file ) == 2;
+    if( ok && isLittleEndian( ) )
+        ok = fwrite( moveSequence, sizeof(double), numMoves, out_file ) == (size_t)numMoves;
+    for( i=0; ok && !isLittleEndian( ) && i<numMoves; i++ ){
+        move = moveSequence[i];
+        swapBytes( &move, sizeof(double) );
+        ok = fwrite( &move, sizeof(double), 1, out_file ) == 1;
+    }
+    if( fclose( out_file ) != 0 )
+        ok = false;
+    if( !ok )
+        fprintf( stderr, "Failed to write %s\n", fileName );
+    return ok;
+}
+
+
+/**********  Functions for parsing numbers **********/
+
+/* parseDouble
+ * input: a pointer to the first character of a number, the end of the text, and a pointer to store the value
+ * output: a pointer just past the number, or NULL if there is no valid number at p
+ *
+ * Locale-free decimal parser.  Numbers with at most 19 significant digits and a small enough exponent are
+ * converted exactly with one multiply or divide by an exact power of ten; anything else falls back to strtod_l
+ * in the "C" locale, so the result does not depend on the process locale.
+ */
+const char* parseDouble( const char* p, const char* end, double* value ){
+    const char *start = p;
+    uint64_t mantissa = 0;
+    int digits = 0, dropped = 0, fraction = 0, exponent = 0;
+    bool negative = false, expNegative = false, any = false, truncated = false;
+    long long expValue = 0;
+
+    if( p < end && ( *p=='-' || *p=='+' ) )
+        negative = *p++ == '-';
+    for( ; p < end && *p>='0' && *p<='9'; p++ ){
+        any = true;
+        if( digits < 19 ){
+            mantissa = mantissa*10 + (*p - '0');
+            if( mantissa != 0 )
+                digits++;
+        }
+        else{
+            dropped++;
+            truncated = true;
+        }
+    }
+    if( p < end && *p=='.' ){
+        for( p++; p < end && *p>='0' && *p<='9'; p++ ){
+            any = true;
+            if( digits < 19 ){
+                mantissa = mantissa*10 + (*p - '0');
+                fraction++;
+                if( mantissa != 0 )
+                    digits++;
+            }
+            else if( *p != '0' )
+                truncated = true;
+        }
+    }
+    if( !any )
+        return NULL;
+    if( p < end && ( *p=='e' || *p=='E' ) ){
+        const char *e = p + 1;
+        if( e < end && ( *e=='-' || *e=='+' ) )
+            expNegative = *e++ == '-';
+        if( e >= end || *e<'0' || *e>'9' )
+            return NULL;
+        for( ; e < end && *e>='0' && *e<='9'; e++ )
+            if( expValue < 100000 )
+                expValue = expValue*10 + (*e - '0');
+        p = e;
+    }
+    exponent = (int)(expNegative ? -expValue : expValue) + dropped - fraction;
+
+    if( mantissa <= (1ULL<<53) && exponent >= -22 && exponent <= 22 && !truncated ){
+        *value = exponent < 0 ? (double)mantissa / exactPowersOfTen[-exponent] : (double)mantissa * exactPowersOfTen[exponent];
+    }
+    else{
+        /* rare case: too many digits or a large exponent, so let the C library round it correctly */
+        char local[128], *buffer = local;
+        size_t length = p - start;
+        if( length >= sizeof(local) ){
+            buffer = malloc( length + 1 );
+            if( buffer==NULL ){
+                fprintf(stderr,"malloc failed\n");
+                exit(-1);
+            }
+        }
+        /* the text is not NUL-terminated (it may end the file mapping), so strtod_l gets a copy */
+        memcpy( buffer, start, length );
+        buffer[length] = '\0';
+        pthread_once( &cLocaleOnce, initCLocale );
+        *value = strtod_l( buffer, NULL, cLocale );
+        if( buffer != local )
+            free( buffer );
+        return p;
+    }
+    if( negative )
+        *value = -*value;
+    return p;
+}
+
+/* initCLocale
+ * input: none
+ * output: none
+ *
+ * Creates the "C" locale for parseDouble.  Run through pthread_once, so it is safe to reach from worker threads.
+ */
+void initCLocale( ){
+    cLocale = newlocale( LC_NUMERIC_MASK, "C", (locale_t)0 );
+    if( cLocale==(locale_t)0 ){
+        fprintf(stderr,"newlocale failed\n");
+        exit(-1);
+    }
+}
+
+/* parseLong
+ * input: a pointer to the first character of an integer, the end of the text, and a pointer to store the value
+ * output: a pointer just past the integer, or NULL if there is no valid integer at p
+ *
+ * Parses an optionally signed decimal integer
+ */
+const char* parseLong( const char* p, const char* end, long long* value ){
+    bool negative = false, any = false;
+    long long v = 0;
+
+    if( p < end && ( *p=='-' || *p=='+' ) )
+        negative = *p++ == '-';
+    for( ; p < end && *p>='0' && *p<='9'; p++ ){
+        any = true;
+        if( v < 1000000000000LL )
+            v = v*10 + (*p - '0');
+    }
+    if( !any || ( p < end && !isSpace( *p ) ) )
+        return NULL;
+    *value = negative ? -v : v;
+    return p;
+}
+
+/* isSpace and skipSpaces
+ * input: a char / a range of text
+ * output: a boolean / a pointer to the first non-whitespace character (or end)
+ *
+ * Locale-free whitespace handling
+ */
+bool isSpace( char c ){
+    return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\v' || c=='\f';
+}
+
+const char* skipSpaces( const char* p, const char* end ){
+    while( p < end && isSpace( *p ) )
+        p++;
+    return p;
+}
+
+/* isLittleEndian and swapBytes
+ * input: none / a pointer to a value and its size
+ * output: a boolean / none
+ *
+ * Byte order helpers for the binary format
+ */
+bool isLittleEndian( ){
+    uint16_t one = 1;
+    return *(uint8_t*)&one == 1;
+}
+
+void swapBytes( void* p, size_t size ){
+    uint8_t *b = (uint8_t*)p, tmp;
+    size_t i;
+    for( i=0; i<size/2; i++ ){
+        tmp = b[i];
+        b[i] = b[size-1-i];
+        b[size-1-i] = tmp;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef _loader_h
+#define _loader_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* First 8 bytes of a binary CTP file, followed by the little-endian int64 number of moves, the int64 provided
+ * solution and then the moves as little-endian IEEE-754 doubles */
+#define CTP_BINARY_MAGIC "CTPBIN01"
+
+/* Text files smaller than this per thread are parsed by a single thread */
+#ifndef LOADER_MIN_CHUNK
+#define LOADER_MIN_CHUNK (1<<22)
+#endif
+
+/**********  Functions for loading CTP files **********/
+bool loadMoves( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves, int numThreads );
+bool loadMovesText( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves, int numThreads );
+bool loadMovesBinary( char* fileName, double** pmoveSequence, int* pprovidedSolution, int* pnumMoves );
+bool saveMovesBinary( char* fileName, double* moveSequence, int providedSolution, int numMoves );
+
+/**********  Functions for parsing numbers **********/
+const char* parseDouble( const char* p, const char* end, double* value );
+const char* parseLong( const char* p, const char* end, long long* value );
+bool isSpace( char c );
+
+/**********  Functions for byte order **********/
+bool isLittleEndian( );
+void swapBytes( void* p, size_t size );
+
+#endif
@@ -0,0 +1,173 @@
+#include <limits.h>
+
+#include "multiQueue.h"
+
+/*
+ * Per-thread state of the xorshift generator used to pick lanes
+ */
+static __thread unsigned int mqSeed = 0;
+
+unsigned int randomLaneMQ( MultiQueue *pmq );
+void updateTopMQ( MQLane *lane );
+pqType scanRemoveMQ( MultiQueue *pmq );
+
+/* createMQ
+ * input: the number of internal heaps
+ * output: a pointer to a MultiQueue (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates a new empty MultiQueue with numLanes internal heaps and returns a pointer to it.
+ * A good choice for numLanes is a small multiple (2-4) of the number of threads using the queue.
+ */
+MultiQueue *createMQ( int numLanes ){
+    int i;
+    MultiQueue *pmq = (MultiQueue *)malloc( sizeof(MultiQueue) );
+    if( numLanes < 1 )
+        numLanes = 1;
+    pmq->numLanes = numLanes;
+    if( posix_memalign( (void**)&pmq->lanes, 64, numLanes*sizeof(MQLane) ) != 0 ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+
+    for( i=0; i<numLanes; i++ ){
+        pthread_mutex_init( &pmq->lanes[i].lock, NULL );
+        pmq->lanes[i].pq = createPQ( );
+        pmq->lanes[i].top = LLONG_MAX;
+    }
+    return pmq;
+}
+
+/* freeMQ
+ * input: a pointer to a MultiQueue
+ * output: none
+ *
+ * frees the given MultiQueue pointer.  Like freePQ it does not free the elements still stored in it.
+ */
+void freeMQ( MultiQueue *pmq ){
+    int i;
+    for( i=0; i<pmq->numLanes; i++ ){
+        pthread_mutex_destroy( &pmq->lanes[i].lock );
+        freePQ( pmq->lanes[i].pq );
+    }
+    free( pmq->lanes );
+    free( pmq );
+}
+
+/* insertMQ
+ * input: a pointer to a MultiQueue, a pqType
+ * output: none
+ *
+ * inserts the pqType into a randomly chosen internal heap.  Lanes that are currently locked are skipped.
+ */
+void insertMQ( MultiQueue *pmq, pqType pt ){
+    MQLane *lane;
+    while( true ){
+        lane = &pmq->lanes[ randomLaneMQ( pmq ) ];
+        if( pthread_mutex_trylock( &lane->lock ) == 0 )
+            break;
+    }
+    insertPQ( lane->pq, pt );
+    updateTopMQ( lane );
+    pthread_mutex_unlock( &lane->lock );
+}
+
+/* removeMQ
+ * input: a pointer to a MultiQueue
+ * output: a pqType
+ *
+ * removes and returns an element with (approximately) the smallest priority.  Two random lanes are sampled
+ * and the one with the better front element is popped.  Returns NULL if every lane is empty.
+ */
+pqType removeMQ( MultiQueue *pmq ){
+    MQLane *lane, *other;
+    pqType ret;
+    int emptySamples = 0;
+
+    while( emptySamples < pmq->numLanes ){
+        lane = &pmq->lanes[ randomLaneMQ( pmq ) ];
+        other = &pmq->lanes[ randomLaneMQ( pmq ) ];
+        if( __atomic_load_n( &other->top, __ATOMIC_RELAXED ) < __atomic_load_n( &lane->top, __ATOMIC_RELAXED ) )
+            lane = other;
+
+        if( __atomic_load_n( &lane->top, __ATOMIC_RELAXED ) == LLONG_MAX ){
+            emptySamples++;
+            continue;
+        }
+        if( pthread_mutex_trylock( &lane->lock ) != 0 )
+            continue;
+        if( isEmptyPQ( lane->pq ) ){ /* another thread emptied it since we sampled */
+            pthread_mutex_unlock( &lane->lock );
+            continue;
+        }
+        ret = removePQ( lane->pq );
+        updateTopMQ( lane );
+        pthread_mutex_unlock( &lane->lock );
+        return ret;
+    }
+
+    /* The samples kept hitting empty lanes, so check every lane before reporting empty */
+    return scanRemoveMQ( pmq );
+}
+
+/* isEmptyMQ
+ * input: a pointer to a MultiQueue
+ * output: a boolean
+ *
+ * returns TRUE if every lane was empty when it was checked and FALSE otherwise
+ */
+bool isEmptyMQ( MultiQueue *pmq ){
+    int i;
+    for( i=0; i<pmq->numLanes; i++ ){
+        if( __atomic_load_n( &pmq->lanes[i].top, __ATOMIC_RELAXED ) != LLONG_MAX )
+            return false;
+    }
+    return true;
+}
+
+/* scanRemoveMQ
+ * input: a pointer to a MultiQueue
+ * output: a pqType
+ *
+ * Locks each lane in turn and removes from the first non-empty one.  Returns NULL if all lanes are empty.
+ */
+pqType scanRemoveMQ( MultiQueue *pmq ){
+    int i;
+    pqType ret = NULL;
+    for( i=0; i<pmq->numLanes && ret==NULL; i++ ){
+        MQLane *lane = &pmq->lanes[i];
+        pthread_mutex_lock( &lane->lock );
+        if( !isEmptyPQ( lane->pq ) ){
+            ret = removePQ( lane->pq );
+            updateTopMQ( lane );
+        }
+        pthread_mutex_unlock( &lane->lock );
+    }
+    return ret;
+}
+
+/* updateTopMQ
+ * input: a pointer to a locked MQLane
+ * output: none
+ *
+ * Refreshes the cached front priority that removeMQ compares without locking.  An empty lane caches LLONG_MAX,
+ * which no int priority can equal, so a lane whose front element has priority INT_MAX is not mistaken for empty.
+ */
+void updateTopMQ( MQLane *lane ){
+    long long top = isEmptyPQ( lane->pq ) ? LLONG_MAX : getNextPQ( lane->pq )->priority;
+    __atomic_store_n( &lane->top, top, __ATOMIC_RELAXED );
+}
+
+/* randomLaneMQ
+ * input: a pointer to a MultiQueue
+ * output: an index into pmq->lanes
+ *
+ * Returns a random lane index using a per-thread xorshift generator
+ */
+unsigned int randomLaneMQ( MultiQueue *pmq ){
+    if( mqSeed == 0 )
+        mqSeed = (unsigned int)(size_t)&mqSeed | 1;
+    mqSeed ^= mqSeed << 13;
+    mqSeed ^= mqSeed >> 17;
+    mqSeed ^= mqSeed << 5;
+    return mqSeed % pmq->numLanes;
+}
@@ -0,0 +1,34 @@
+#ifndef _multiQueue_h
+#define _multiQueue_h
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "priorityQueue.h"
+
+/*
+ * One internal heap of the MultiQueue.  Each lane is padded out to its own cache line so that
+ * threads working on different lanes do not contend on the same line.
+ */
+typedef struct MQLane
+{
+    pthread_mutex_t lock;       /* protects pq */
+    PriorityQueue *pq;          /* heap holding this lane's elements */
+    long long top;              /* cached priority of the front element (LLONG_MAX when empty, above any int) */
+} __attribute__((aligned(64))) MQLane;
+
+typedef struct MultiQueue
+{
+    MQLane *lanes;          /* array of internal heaps */
+    int numLanes;           /* number of internal heaps */
+} MultiQueue;
+
+MultiQueue *createMQ( int numLanes );
+void freeMQ( MultiQueue *pmq );
+
+void insertMQ( MultiQueue *pmq, pqType pt );
+pqType removeMQ( MultiQueue *pmq );
+
+bool isEmptyMQ( MultiQueue *pmq );
+
+#endif
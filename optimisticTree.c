@@ -0,0 +1,304 @@
+#include <string.h>
+
+#include "optimisticTree.h"
+
+/* Result of one lock-free search attempt */
+typedef enum otAttempt{ OT_FOUND, OT_MISSING, OT_RETRY } otAttempt;
+
+/*
+ * Per-thread hint of the reader slot to try first, so that a thread keeps reusing the same slot
+ */
+static __thread int otSlotHint = -1;
+static int otNextSlot = 0;
+
+otAttempt trySearchOT( OptimisticTree *ot, char *key, int *pverification );
+int enterReaderOT( OptimisticTree *ot );
+void exitReaderOT( OptimisticTree *ot, int slot );
+void retireTNodeOT( void *arg, TNode *node );
+void retireOT( OptimisticTree *ot, void *ptr, bool isData );
+void reserveRetiredOT( OptimisticTree *ot, int extra );
+void reclaimOT( OptimisticTree *ot );
+
+/* createOT
+ * input: none
+ * output: a pointer to an OptimisticTree (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates a new empty OptimisticTree and returns a pointer to it
+ */
+OptimisticTree *createOT( ){
+    OptimisticTree *ot = (OptimisticTree *)malloc( sizeof(OptimisticTree) );
+    if( ot == NULL || posix_memalign( (void**)&ot->readers, 64, OT_MAX_READERS*sizeof(OTReaderSlot) ) != 0 ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    memset( ot->readers, 0, OT_MAX_READERS*sizeof(OTReaderSlot) );
+
+    ot->tree = createTree( );
+    ot->tree->type = AVL;
+    ot->tree->retireTNode = retireTNodeOT;
+    ot->tree->retireArg = ot;
+    pthread_mutex_init( &ot->writeLock, NULL );
+    ot->epoch = 1;  /* 0 marks an idle reader slot */
+    ot->retired = NULL;
+    ot->numRetired = ot->retiredCapacity = 0;
+    return ot;
+}
+
+/* freeOT
+ * input: a pointer to an OptimisticTree
+ * output: none
+ *
+ * frees the given OptimisticTree and all of the Data elements stored in it.  No thread may still be using it.
+ */
+void freeOT( OptimisticTree *ot ){
+    int i;
+    for( i=0; i<ot->numRetired; i++ ){
+        if( ot->retired[i].isData )
+            freeData( (Data *)ot->retired[i].ptr );
+        else
+            freeTNode( ot->tree, (TNode *)ot->retired[i].ptr );
+    }
+    free( ot->retired );
+    freeTree( ot->tree );
+    pthread_mutex_destroy( &ot->writeLock );
+    free( ot->readers );
+    free( ot );
+}
+
+/* insertOT
+ * input: a pointer to an OptimisticTree, a Data*
+ * output: a boolean
+ *
+ * Stores tData in the tree and returns TRUE, or returns FALSE (leaving tData with the caller) if its key is
+ * already in the tree.  Once stored, tData belongs to the tree.
+ */
+bool insertOT( OptimisticTree *ot, Data *tData ){
+    bool inserted = false;
+
+    pthread_mutex_lock( &ot->writeLock );
+    if( searchTree( ot->tree, tData )->leaf ){
+        insertTreeBalanced( ot->tree, tData );
+        inserted = true;
+    }
+    pthread_mutex_unlock( &ot->writeLock );
+    return inserted;
+}
+
+/* removeOT
+ * input: a pointer to an OptimisticTree, a key
+ * output: a boolean
+ *
+ * Removes the Data stored under key and returns TRUE, or returns FALSE if there is none.  Readers may still be
+ * looking at the removed Data and nodes, so they are only freed once every reader that could have seen them is done.
+ */
+bool removeOT( OptimisticTree *ot, char *key ){
+    Data *removed;
+
+    pthread_mutex_lock( &ot->writeLock );
+    reserveRetiredOT( ot, 3 );  /* a removal retires at most two nodes and one Data */
+    removed = removeTree( ot->tree, key );
+    if( removed != NULL ){
+        retireOT( ot, removed, true );
+        __atomic_add_fetch( &ot->epoch, 1, __ATOMIC_SEQ_CST );
+        if( ot->numRetired >= OT_RECLAIM_BATCH )
+            reclaimOT( ot );
+    }
+    pthread_mutex_unlock( &ot->writeLock );
+    return removed != NULL;
+}
+
+/* searchOT
+ * input: a pointer to an OptimisticTree, a key, and a pointer to store the Data's verification in (or NULL)
+ * output: a boolean
+ *
+ * Returns TRUE if key is in the tree, without taking any lock.  The search records the version of every node on
+ * its path and retries if any of them changed, so it never returns an answer that no single moment of the tree
+ * would give.  After OT_MAX_RETRIES failed attempts (or when every reader slot is busy) it takes the writer lock.
+ */
+bool searchOT( OptimisticTree *ot, char *key, int *pverification ){
+    int attempt, slot;
+    otAttempt result = OT_RETRY;
+    Data temp;
+    TNode *found;
+
+    slot = enterReaderOT( ot );
+    if( slot >= 0 ){
+        for( attempt=0; attempt<OT_MAX_RETRIES && result == OT_RETRY; attempt++ )
+            result = trySearchOT( ot, key, pverification );
+        exitReaderOT( ot, slot );
+    }
+    if( result != OT_RETRY )
+        return result == OT_FOUND;
+
+    pthread_mutex_lock( &ot->writeLock );
+    temp.key = key;
+    found = searchTree( ot->tree, &temp );
+    if( !found->leaf && pverification != NULL )
+        *pverification = found->data->verification;
+    pthread_mutex_unlock( &ot->writeLock );
+    return !found->leaf;
+}
+
+/* trySearchOT
+ * input: a pointer to an OptimisticTree, a key, and a pointer to store the Data's verification in (or NULL)
+ * output: an otAttempt
+ *
+ * One lock-free descent.  Each node's fields are read between two reads of its version and only used once the
+ * version is confirmed; at the bottom every version on the path is checked again.  The first node must have no
+ * parent, since the tree's root pointer lags behind a rotation at the root, and must still be the tree's root once
+ * the path is validated, since removeTree can detach a root without touching any version on the path.
+ */
+otAttempt trySearchOT( OptimisticTree *ot, char *key, int *pverification ){
+    TNode *path[OT_MAX_DEPTH], *node, *left, *right, *parent;
+    unsigned int versions[OT_MAX_DEPTH], version;
+    int i, depth = 0, cmp;
+    bool leaf;
+    Data *data;
+    otAttempt result;
+
+    node = __atomic_load_n( &ot->tree->root, __ATOMIC_ACQUIRE );
+    while( true ){
+        if( depth == OT_MAX_DEPTH )
+            return OT_RETRY;
+        version = __atomic_load_n( &node->version, __ATOMIC_ACQUIRE );
+        if( version & 1 )
+            return OT_RETRY;    /* a writer is changing this node */
+
+        leaf = __atomic_load_n( &node->leaf, __ATOMIC_RELAXED );
+        data = __atomic_load_n( &node->data, __ATOMIC_RELAXED );
+        left = __atomic_load_n( &node->pLeft, __ATOMIC_RELAXED );
+        right = __atomic_load_n( &node->pRight, __ATOMIC_RELAXED );
+        parent = __atomic_load_n( &node->pParent, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        if( __atomic_load_n( &node->version, __ATOMIC_RELAXED ) != version )
+            return OT_RETRY;
+        if( depth == 0 && parent != NULL )
+            return OT_RETRY;    /* not the root any more */
+        path[depth] = node;
+        versions[depth++] = version;
+
+        if( leaf ){
+            result = OT_MISSING;
+            break;
+        }
+        cmp = strcmp( key, data->key );
+        if( cmp == 0 ){
+            if( pverification != NULL )
+                *pverification = data->verification;
+            result = OT_FOUND;
+            break;
+        }
+        node = cmp < 0 ? left : right;
+    }
+
+    /* the path is a consistent snapshot only if no node on it changed while it was walked */
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    for( i=0; i<depth; i++ ){
+        if( __atomic_load_n( &path[i]->version, __ATOMIC_RELAXED ) != versions[i] )
+            return OT_RETRY;
+    }
+    if( path[0] != __atomic_load_n( &ot->tree->root, __ATOMIC_ACQUIRE ) )
+        return OT_RETRY;    /* the walk started at a detached root */
+    return result;
+}
+
+
+/**********  Functions for reclaiming removed nodes **********/
+
+/* enterReaderOT and exitReaderOT
+ * input: a pointer to an OptimisticTree (and the slot returned by enterReaderOT)
+ * output: the reader slot claimed (or -1 if every slot is busy) / none
+ *
+ * Announce the current epoch in a free reader slot for the duration of a search, so that the writer keeps every
+ * node and Data removed in that epoch or later alive
+ */
+int enterReaderOT( OptimisticTree *ot ){
+    int i, k;
+    unsigned long idle, epoch = __atomic_load_n( &ot->epoch, __ATOMIC_SEQ_CST );
+
+    if( otSlotHint < 0 )
+        otSlotHint = __atomic_fetch_add( &otNextSlot, 1, __ATOMIC_RELAXED ) % OT_MAX_READERS;
+    for( k=0; k<OT_MAX_READERS; k++ ){
+        i = (otSlotHint + k) % OT_MAX_READERS;
+        idle = 0;
+        if( __atomic_compare_exchange_n( &ot->readers[i].epoch, &idle, epoch, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ) ){
+            otSlotHint = i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void exitReaderOT( OptimisticTree *ot, int slot ){
+    __atomic_store_n( &ot->readers[slot].epoch, 0, __ATOMIC_RELEASE );
+}
+
+/* retireTNodeOT and retireOT
+ * input: a pointer to an OptimisticTree and a removed node or Data
+ * output: none
+ *
+ * Queue a removed node or Data to be freed once no reader can reach it.  Called with the writer lock held.
+ */
+void retireTNodeOT( void *arg, TNode *node ){
+    retireOT( (OptimisticTree *)arg, node, false );
+}
+
+void retireOT( OptimisticTree *ot, void *ptr, bool isData ){
+    reserveRetiredOT( ot, 1 );
+    ot->retired[ot->numRetired].ptr = ptr;
+    ot->retired[ot->numRetired].isData = isData;
+    ot->retired[ot->numRetired].epoch = ot->epoch;
+    ot->numRetired++;
+}
+
+/* reserveRetiredOT
+ * input: a pointer to an OptimisticTree and a number of entries
+ * output: none
+ *
+ * Makes room for extra more retired entries
+ */
+void reserveRetiredOT( OptimisticTree *ot, int extra ){
+    int capacity;
+    OTRetired *grown;
+
+    if( ot->numRetired + extra <= ot->retiredCapacity )
+        return;
+    capacity = ot->retiredCapacity > 0 ? 2*ot->retiredCapacity : OT_RECLAIM_BATCH;
+    while( capacity < ot->numRetired + extra )
+        capacity *= 2;
+    grown = (OTRetired *)realloc( ot->retired, capacity*sizeof(OTRetired) );
+    if( grown == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    ot->retired = grown;
+    ot->retiredCapacity = capacity;
+}
+
+/* reclaimOT
+ * input: a pointer to an OptimisticTree
+ * output: none
+ *
+ * Frees every retired entry removed before the oldest epoch any active reader announced.  A reader that
+ * announced a later epoch started after those entries were unlinked, so it cannot reach them.
+ */
+void reclaimOT( OptimisticTree *ot ){
+    int i, kept = 0;
+    unsigned long epoch, oldest = __atomic_load_n( &ot->epoch, __ATOMIC_SEQ_CST );
+
+    for( i=0; i<OT_MAX_READERS; i++ ){
+        epoch = __atomic_load_n( &ot->readers[i].epoch, __ATOMIC_SEQ_CST );
+        if( epoch != 0 && epoch < oldest )
+            oldest = epoch;
+    }
+
+    for( i=0; i<ot->numRetired; i++ ){
+        if( ot->retired[i].epoch >= oldest )
+            ot->retired[kept++] = ot->retired[i];
+        else if( ot->retired[i].isData )
+            freeData( (Data *)ot->retired[i].ptr );
+        else
+            freeTNode( ot->tree, (TNode *)ot->retired[i].ptr );
+    }
+    ot->numRetired = kept;
+}
@@ -0,0 +1,57 @@
+#ifndef _optimisticTree_h
+#define _optimisticTree_h
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tree.h"
+#include "data.h"
+
+/* Most threads that may read an OptimisticTree at the same time */
+#define OT_MAX_READERS 128
+
+/* Deepest path a lock-free search records (an AVL tree of 2^31 keys is at most 45 deep) */
+#define OT_MAX_DEPTH 64
+
+/* Failed lock-free attempts before a search falls back to the writer lock */
+#define OT_MAX_RETRIES 16
+
+/* Removed nodes and data collected before the writer tries to free them */
+#define OT_RECLAIM_BATCH 256
+
+/*
+ * Epoch announced by one reader while it searches (0 when idle).  Each slot has its own cache line so that
+ * readers never write to a line another reader uses.
+ */
+typedef struct OTReaderSlot
+{
+    unsigned long epoch;
+} __attribute__((aligned(64))) OTReaderSlot;
+
+/* A node or Data removed from the tree that readers may still be looking at */
+typedef struct OTRetired
+{
+    void *ptr;
+    bool isData;            /* free with freeData instead of free */
+    unsigned long epoch;    /* writer epoch in which it was removed */
+} OTRetired;
+
+/* AVL tree whose searches take no locks: writers serialize on a mutex, readers validate node versions */
+typedef struct OptimisticTree
+{
+    Tree *tree;
+    pthread_mutex_t writeLock;      /* held by inserts and removes */
+    unsigned long epoch;            /* advanced by the writer after every removal */
+    OTReaderSlot *readers;          /* OT_MAX_READERS announcement slots */
+    OTRetired *retired;             /* removed nodes and data not yet freed */
+    int numRetired, retiredCapacity;
+} OptimisticTree;
+
+OptimisticTree *createOT( );
+void freeOT( OptimisticTree *ot );
+
+bool insertOT( OptimisticTree *ot, Data *tData );
+bool removeOT( OptimisticTree *ot, char *key );
+bool searchOT( OptimisticTree *ot, char *key, int *pverification );
+
+#endif
@@ -0,0 +1,351 @@
+#include <string.h>
+
+#include "persistentTree.h"
+
+PNode *createPNode( PTEntry *entry, PNode *left, PNode *right );
+PNode *retainPNode( PNode *node );
+void releasePNode( PNode *node );
+int heightPNode( PNode *node );
+PNode *balancePNode( PTEntry *entry, PNode *left, PNode *right );
+PNode *insertPNode( PNode *root, PTEntry *entry );
+PNode *removePNode( PNode *root, char *key );
+PNode *removeMinPNode( PNode *root );
+Data *searchPNode( PNode *root, char *key );
+void scanPNode( PNode *root, void (*visit)( Data*, void* ), void *arg );
+void publishPT( PersistentTree *pt, PNode *root, int size );
+
+/**********  Functions for creating/freeing a persistent tree **********/
+
+/* createPT
+ * input: none
+ * output: a pointer to a PersistentTree (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates a new empty PersistentTree and returns a pointer to it
+ */
+PersistentTree *createPT( ){
+    PersistentTree *pt = (PersistentTree *)malloc( sizeof(PersistentTree) );
+    if( pt == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    pt->root = NULL;
+    pt->size = 0;
+    pthread_mutex_init( &pt->writeLock, NULL );
+    pthread_mutex_init( &pt->rootLock, NULL );
+    return pt;
+}
+
+/* freePT
+ * input: a pointer to a PersistentTree
+ * output: none
+ *
+ * frees the given PersistentTree and its current version.  Snapshots taken earlier stay valid: their nodes and
+ * Data are freed when the last snapshot holding them is released.
+ */
+void freePT( PersistentTree *pt ){
+    releasePNode( pt->root );
+    pthread_mutex_destroy( &pt->writeLock );
+    pthread_mutex_destroy( &pt->rootLock );
+    free( pt );
+}
+
+
+/**********  Functions for updating a persistent tree **********/
+
+/* insertPT
+ * input: a pointer to a PersistentTree, a Data*
+ * output: a boolean
+ *
+ * Publishes a new version holding tData and returns TRUE, or returns FALSE (leaving tData with the caller) if its key
+ * is already in the tree.  Only the O(log n) nodes on the path to tData are copied.  Once stored, tData belongs to
+ * the tree and is freed when no version refers to it any more.
+ */
+bool insertPT( PersistentTree *pt, Data *tData ){
+    bool inserted = false;
+    PTEntry *entry;
+
+    pthread_mutex_lock( &pt->writeLock );
+    if( searchPNode( pt->root, tData->key ) == NULL ){
+        entry = (PTEntry *)malloc( sizeof(PTEntry) );
+        if( entry == NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+        entry->data = tData;
+        entry->refs = 0;
+        publishPT( pt, insertPNode( pt->root, entry ), pt->size + 1 );
+        inserted = true;
+    }
+    pthread_mutex_unlock( &pt->writeLock );
+    return inserted;
+}
+
+/* removePT
+ * input: a pointer to a PersistentTree, a key
+ * output: a boolean
+ *
+ * Publishes a new version without key and returns TRUE, or returns FALSE if key is not in the tree.  Snapshots
+ * taken before the removal still see the key.
+ */
+bool removePT( PersistentTree *pt, char *key ){
+    bool removed = false;
+
+    pthread_mutex_lock( &pt->writeLock );
+    if( searchPNode( pt->root, key ) != NULL ){
+        publishPT( pt, removePNode( pt->root, key ), pt->size - 1 );
+        removed = true;
+    }
+    pthread_mutex_unlock( &pt->writeLock );
+    return removed;
+}
+
+/* publishPT
+ * input: a pointer to a PersistentTree, the root of its new version and the version's size
+ * output: none
+ *
+ * Makes root the current version and drops the tree's reference to the old one.  Called with the writer lock held.
+ * rootLock keeps a concurrent snapshotPT from retaining the old root after its last reference is dropped; it is
+ * held only for the swap, so readers can delay a writer by no more than that.
+ */
+void publishPT( PersistentTree *pt, PNode *root, int size ){
+    PNode *old;
+
+    pthread_mutex_lock( &pt->rootLock );
+    old = pt->root;
+    pt->root = root;
+    pt->size = size;
+    pthread_mutex_unlock( &pt->rootLock );
+    releasePNode( old );
+}
+
+
+/**********  Functions for reading versions of a persistent tree **********/
+
+/* snapshotPT and releasePTSnapshot
+ * input: a pointer to a PersistentTree / a snapshot
+ * output: a snapshot of the current version / none
+ *
+ * Taking a snapshot only adds a reference to the current root, so it costs O(1) and never waits for a writer
+ * copying a path.  The reference is taken under rootLock, so snapshotPT is not lock-free: it can wait for a publish
+ * or another snapshot, and a writer's publish can wait for it, but only for the few instructions that swap or
+ * retain the root.  The snapshot never changes and can be read by any number of threads without locks until it is
+ * released.
+ */
+PTSnapshot snapshotPT( PersistentTree *pt ){
+    PTSnapshot snap;
+
+    pthread_mutex_lock( &pt->rootLock );
+    snap.root = retainPNode( pt->root );
+    snap.size = pt->size;
+    pthread_mutex_unlock( &pt->rootLock );
+    return snap;
+}
+
+void releasePTSnapshot( PTSnapshot *snap ){
+    releasePNode( snap->root );
+    snap->root = NULL;
+    snap->size = 0;
+}
+
+/* searchPTSnapshot
+ * input: a snapshot, a key
+ * output: a Data*
+ *
+ * Returns the Data stored under key in the snapshot, or NULL if there is none.  The Data stays valid until the
+ * snapshot is released.
+ */
+Data *searchPTSnapshot( PTSnapshot *snap, char *key ){
+    return searchPNode( snap->root, key );
+}
+
+/* scanPTSnapshot
+ * input: a snapshot, a callback and its argument
+ * output: none
+ *
+ * Calls visit on every Data of the snapshot in key order
+ */
+void scanPTSnapshot( PTSnapshot *snap, void (*visit)( Data*, void* ), void *arg ){
+    scanPNode( snap->root, visit, arg );
+}
+
+/* searchPT
+ * input: a pointer to a PersistentTree, a key, and a pointer to store the Data's verification in (or NULL)
+ * output: a boolean
+ *
+ * Returns TRUE if key is in the current version
+ */
+bool searchPT( PersistentTree *pt, char *key, int *pverification ){
+    PTSnapshot snap = snapshotPT( pt );
+    Data *found = searchPTSnapshot( &snap, key );
+
+    if( found != NULL && pverification != NULL )
+        *pverification = found->verification;
+    releasePTSnapshot( &snap );
+    return found != NULL;
+}
+
+
+/**********  Helper functions for persistent nodes **********/
+
+/* createPNode
+ * input: a PTEntry and the node's two subtrees
+ * output: a new PNode with one reference
+ *
+ * The new node takes over the caller's references to left and right and adds one to entry
+ */
+PNode *createPNode( PTEntry *entry, PNode *left, PNode *right ){
+    PNode *node = (PNode *)malloc( sizeof(PNode) );
+    int hl = heightPNode( left ), hr = heightPNode( right );
+
+    if( node == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    node->entry = entry;
+    node->pLeft = left;
+    node->pRight = right;
+    node->height = 1 + ( hl > hr ? hl : hr );
+    node->refs = 1;
+    __atomic_add_fetch( &entry->refs, 1, __ATOMIC_RELAXED );
+    return node;
+}
+
+/* retainPNode and releasePNode
+ * input: a PNode (or NULL)
+ * output: the same PNode / none
+ *
+ * Add or drop one reference.  A node whose last reference is dropped is freed and drops its references to its
+ * children and its PTEntry, which is freed with its Data once no node points at it.
+ */
+PNode *retainPNode( PNode *node ){
+    if( node != NULL )
+        __atomic_add_fetch( &node->refs, 1, __ATOMIC_RELAXED );
+    return node;
+}
+
+void releasePNode( PNode *node ){
+    PNode *right;
+
+    while( node != NULL && __atomic_sub_fetch( &node->refs, 1, __ATOMIC_ACQ_REL ) == 0 ){
+        releasePNode( node->pLeft );
+        if( __atomic_sub_fetch( &node->entry->refs, 1, __ATOMIC_ACQ_REL ) == 0 ){
+            freeData( node->entry->data );
+            free( node->entry );
+        }
+        right = node->pRight;
+        free( node );
+        node = right;   /* loop instead of recursing on the right subtree */
+    }
+}
+
+int heightPNode( PNode *node ){
+    return node == NULL ? 0 : node->height;
+}
+
+/* balancePNode
+ * input: a PTEntry and the two subtrees to put below it (the caller's references to them are taken over)
+ * output: the root of a balanced subtree holding them
+ *
+ * Builds the node for entry, rotating when the subtrees' heights differ by two.  The subtrees may be shared with
+ * other versions, so a rotation builds new nodes instead of relinking the old ones.
+ */
+PNode *balancePNode( PTEntry *entry, PNode *left, PNode *right ){
+    PNode *root, *child, *grandchild;
+
+    if( heightPNode( left ) > heightPNode( right ) + 1 ){
+        child = left;
+        if( heightPNode( child->pLeft ) >= heightPNode( child->pRight ) )    /* right rotation */
+            root = createPNode( child->entry, retainPNode( child->pLeft ),
+                                createPNode( entry, retainPNode( child->pRight ), right ) );
+        else{   /* left-right rotation */
+            grandchild = child->pRight;
+            root = createPNode( grandchild->entry,
+                                createPNode( child->entry, retainPNode( child->pLeft ), retainPNode( grandchild->pLeft ) ),
+                                createPNode( entry, retainPNode( grandchild->pRight ), right ) );
+        }
+        releasePNode( child );
+        return root;
+    }
+    if( heightPNode( right ) > heightPNode( left ) + 1 ){
+        child = right;
+        if( heightPNode( child->pRight ) >= heightPNode( child->pLeft ) )    /* left rotation */
+            root = createPNode( child->entry, createPNode( entry, left, retainPNode( child->pLeft ) ),
+                                retainPNode( child->pRight ) );
+        else{   /* right-left rotation */
+            grandchild = child->pLeft;
+            root = createPNode( grandchild->entry,
+                                createPNode( entry, left, retainPNode( grandchild->pLeft ) ),
+                                createPNode( child->entry, retainPNode( grandchild->pRight ), retainPNode( child->pRight ) ) );
+        }
+        releasePNode( child );
+        return root;
+    }
+    return createPNode( entry, left, right );
+}
+
+/* insertPNode, removePNode and removeMinPNode
+ * input: the root of a version (which is left unchanged) and the PTEntry to insert / key to remove
+ * output: the root of a new version with one reference
+ *
+ * Copy the path down to the change and share every other subtree with the old version.  insertPNode requires the
+ * key to be absent and removePNode requires it to be present.
+ */
+PNode *insertPNode( PNode *root, PTEntry *entry ){
+    if( root == NULL )
+        return createPNode( entry, NULL, NULL );
+    if( compareData( entry->data, root->entry->data ) < 0 )
+        return balancePNode( root->entry, insertPNode( root->pLeft, entry ), retainPNode( root->pRight ) );
+    return balancePNode( root->entry, retainPNode( root->pLeft ), insertPNode( root->pRight, entry ) );
+}
+
+PNode *removePNode( PNode *root, char *key ){
+    PNode *min;
+    int cmp = strcmp( key, root->entry->data->key );
+
+    if( cmp < 0 )
+        return balancePNode( root->entry, removePNode( root->pLeft, key ), retainPNode( root->pRight ) );
+    if( cmp > 0 )
+        return balancePNode( root->entry, retainPNode( root->pLeft ), removePNode( root->pRight, key ) );
+
+    if( root->pLeft == NULL )
+        return retainPNode( root->pRight );
+    if( root->pRight == NULL )
+        return retainPNode( root->pLeft );
+    /* replace the removed Data with the next one in order */
+    min = root->pRight;
+    while( min->pLeft != NULL )
+        min = min->pLeft;
+    return balancePNode( min->entry, retainPNode( root->pLeft ), removeMinPNode( root->pRight ) );
+}
+
+PNode *removeMinPNode( PNode *root ){
+    if( root->pLeft == NULL )
+        return retainPNode( root->pRight );
+    return balancePNode( root->entry, removeMinPNode( root->pLeft ), retainPNode( root->pRight ) );
+}
+
+/* searchPNode and scanPNode
+ * input: the root of a version, a key / a callback and its argument
+ * output: the Data stored under key or NULL / none
+ *
+ * Read a version without locks; the caller must hold a reference to it
+ */
+Data *searchPNode( PNode *root, char *key ){
+    int cmp;
+
+    while( root != NULL ){
+        cmp = strcmp( key, root->entry->data->key );
+        if( cmp == 0 )
+            return root->entry->data;
+        root = cmp < 0 ? root->pLeft : root->pRight;
+    }
+    return NULL;
+}
+
+void scanPNode( PNode *root, void (*visit)( Data*, void* ), void *arg ){
+    while( root != NULL ){
+        scanPNode( root->pLeft, visit, arg );
+        visit( root->entry->data, arg );
+        root = root->pRight;
+    }
+}
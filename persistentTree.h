@@ -0,0 +1,62 @@
+#ifndef _persistentTree_h
+#define _persistentTree_h
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "data.h"
+
+/* A Data stored in a persistent tree.  refs counts the nodes of every version pointing at it, so the count lives
+ * with the tree and the caller's Data needs no extra field. */
+typedef struct PTEntry
+{
+    Data *data;
+    unsigned int refs;
+} PTEntry;
+
+/*
+ * Node of a persistent AVL tree.  Nodes are never changed once another version can see them: an update copies the
+ * nodes on its path and shares the rest, so a node may have several parents and has no parent pointer.  refs counts
+ * the parents and snapshots holding it; empty subtrees are NULL.
+ */
+typedef struct PNode
+{
+    PTEntry *entry;
+    struct PNode *pLeft, *pRight;
+    int height;                 /* number of nodes on the longest path down from this node */
+    unsigned int refs;
+} PNode;
+
+/* AVL tree whose every version stays readable while it is held: writers serialize on a mutex and publish a new
+ * root, snapshots hold a reference to a root and are read without locks */
+typedef struct PersistentTree
+{
+    PNode *root;                    /* current version (NULL when empty) */
+    int size;                       /* number of keys in the current version */
+    pthread_mutex_t writeLock;      /* held by inserts and removes while they copy a path */
+    pthread_mutex_t rootLock;       /* held only to swap root or to take a reference to it */
+} PersistentTree;
+
+/* A point-in-time version of a PersistentTree */
+typedef struct PTSnapshot
+{
+    PNode *root;
+    int size;
+} PTSnapshot;
+
+/**********  Functions for creating/freeing a persistent tree **********/
+PersistentTree *createPT( );
+void freePT( PersistentTree *pt );
+
+/**********  Functions for updating a persistent tree **********/
+bool insertPT( PersistentTree *pt, Data *tData );
+bool removePT( PersistentTree *pt, char *key );
+
+/**********  Functions for reading versions of a persistent tree **********/
+PTSnapshot snapshotPT( PersistentTree *pt );
+void releasePTSnapshot( PTSnapshot *snap );
+Data *searchPTSnapshot( PTSnapshot *snap, char *key );
+void scanPTSnapshot( PTSnapshot *snap, void (*visit)( Data*, void* ), void *arg );
+bool searchPT( PersistentTree *pt, char *key, int *pverification );
+
+#endif
@@ -1,21 +1,39 @@
 #include "priorityQueue.h"
+#include "instrument.h"
 
 /*
  * Default starting size for the PriorityQueue
  */
 int const PQ_STARTING_CAPACITY = 50;
 
-/* createPQ
- * input: none
+/* createPQ and createPQWithAllocator
+ * input: none / the Allocator to take the queue's memory from (NULL for malloc/free)
  * output: a pointer to a PriorityQueue (this is malloc-ed so must be freed eventually!)
  *
  * Creates a new empty PriorityQueue and returns a pointer to it.
  */
 PriorityQueue *createPQ( ){
-    PriorityQueue *ppq = (PriorityQueue *)malloc( sizeof(PriorityQueue) );
+    return createPQWithAllocator( NULL );
+}
+
+PriorityQueue *createPQWithAllocator( Allocator *allocator ){
+    MemTracker mem;
+    PriorityQueue *ppq;
+
+    initMemTracker( &mem, allocator );
+    ppq = (PriorityQueue *)trackedAlloc( &mem, sizeof(PriorityQueue) );
+    if( ppq == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    ppq->mem = mem;
     ppq->last = -1;
     ppq->capacity = PQ_STARTING_CAPACITY;
-    ppq->data = (pqType *)malloc( sizeof(pqType)*PQ_STARTING_CAPACITY );
+    ppq->data = (pqType *)trackedAlloc( &ppq->mem, sizeof(pqType)*PQ_STARTING_CAPACITY );
+    if( ppq->data == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
 
     return ppq;
 }
@@ -27,8 +45,21 @@ PriorityQueue *createPQ( ){
  * frees the given PriorityQueue pointer.  Also possibly call freePQElements if you want to free every element in the PriorityQueue.
  */
 void freePQ( PriorityQueue *ppq  ){
-    free(ppq->data);
-    free(ppq);
+    MemTracker mem;
+
+    trackedFree( &ppq->mem, ppq->data, ppq->capacity*sizeof(pqType) );
+    mem = ppq->mem;
+    trackedFree( &mem, ppq, sizeof(PriorityQueue) );
+}
+
+/* getPQMemStats
+ * input: a pointer to a PriorityQueue, a pointer to store its MemStats in
+ * output: none
+ *
+ * Reports the memory held by the PriorityQueue and its array.  The elements themselves are not counted.
+ */
+void getPQMemStats( PriorityQueue *ppq, MemStats *out ){
+    *out = ppq->mem.stats;
 }
 
 /* removePQ
@@ -52,6 +83,7 @@ pqType removePQ( PriorityQueue *ppq ){
     left = 2*cur + 1;
     right = 2*cur + 2;
     while( right <= ppq->last ){ //Move down heap and check priority of left and right
+        COUNT( CNT_PQ_SIFT_STEPS );
         if( ppq->data[left]->priority <= ppq->data[right]->priority && ppq->data[left]->priority < last->priority ){
             ppq->data[cur] = ppq->data[left];
             cur = left;
@@ -83,10 +115,16 @@ pqType removePQ( PriorityQueue *ppq ){
  */
 void insertPQ( PriorityQueue *ppq, pqType pt ){
     int cur, parent;
+    pqType *grown;
     if( isFullPQ( ppq ) ){
         /* resize the array */
+        grown = (pqType*)trackedRealloc( &ppq->mem, ppq->data, ppq->capacity*sizeof(pqType), 2*ppq->capacity*sizeof(pqType) );
+        if( grown == NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+        ppq->data = grown;
         ppq->capacity *= 2;
-        ppq->data = (pqType*)realloc( ppq->data, ppq->capacity*sizeof(pqType) );
     }
     ppq->last++;
     cur = ppq->last;
@@ -96,6 +134,7 @@ void insertPQ( PriorityQueue *ppq, pqType pt ){
         parent = -1;
 
     while( parent>=0 && ppq->data[parent]->priority > pt->priority ){ //Ascend heap until pt's priority is correctly ordered
+        COUNT( CNT_PQ_SIFT_STEPS );
         ppq->data[cur] = ppq->data[parent];
         cur = parent;
         if( parent == 0 )
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 
 #include "tree.h"
+#include "allocator.h"
 
 typedef TNode* pqType; /* priority queue stores nodes from our Huffman tree */
 
@@ -12,10 +13,13 @@ typedef struct PriorityQueue
     pqType *data;          /* pqType data stored in the stack */
     int last;              /* index of the last element in the array */
     int capacity;          /* current capacity of stack */
+    MemTracker mem;        /* the PriorityQueue and its array are allocated through this */
 } PriorityQueue;
 
 PriorityQueue *createPQ( );
+PriorityQueue *createPQWithAllocator( Allocator *allocator );
 void freePQ( PriorityQueue *ppq );
+void getPQMemStats( PriorityQueue *ppq, MemStats *out );
 
 pqType removePQ( PriorityQueue *ppq );
 void insertPQ( PriorityQueue *ppq, pqType pt );
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "radixSort.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS 256
+#define RADIX_PASSES 8
+
+typedef struct RadixShared
+{
+    double *a;                  /* array being sorted, also the destination of the final pass */
+    uint64_t *keys, *tmp;       /* ping-pong buffers of sortable keys */
+    int n;
+    int numThreads;
+    int lastPass;               /* last pass that is not skipped (-1 if every key is equal) */
+    bool skip[RADIX_PASSES];    /* passes where every key has the same digit */
+    size_t (*hist)[RADIX_PASSES][RADIX_BUCKETS];    /* per-thread digit counts */
+    size_t (*offsets)[RADIX_BUCKETS];               /* per-thread scatter positions for the current pass */
+    pthread_barrier_t barrier;
+    pthread_mutex_t startLock;  /* workers wait on startCond until every thread that could be created exists */
+    pthread_cond_t startCond;
+    bool started;
+} RadixShared;
+
+typedef struct RadixThreadArgs
+{
+    RadixShared *sh;
+    int id;
+    int begin, end;             /* slice of the array owned by this thread */
+} RadixThreadArgs;
+
+int radixSortImpl( double* a, int n, bool unique );
+int radixSortParallelImpl( double* a, int n, int numThreads, bool unique );
+void *radixSortWorker( void *arg );
+int findPassesToRun( size_t counts[RADIX_PASSES][RADIX_BUCKETS], uint64_t firstKey, int n, bool skip[RADIX_PASSES] );
+int compactBuckets( double* a, size_t start[RADIX_BUCKETS], size_t end[RADIX_BUCKETS] );
+int sortInPlace( double* a, int n, bool unique );
+int compareDoubles( const void* a, const void* b );
+
+/* doubleToRadixKey and radixKeyToDouble
+ * input: a double / a key
+ * output: a key / a double
+ *
+ * Maps the IEEE-754 bits of a double to an unsigned key with the same ordering: negative numbers have all
+ * bits flipped and positive numbers have only the sign bit flipped.  -0.0 is folded into 0.0.
+ */
+uint64_t doubleToRadixKey( double d ){
+    uint64_t u;
+    if( d == 0 )
+        d = 0;
+    memcpy( &u, &d, sizeof(u) );
+    return (u >> 63) ? ~u : u ^ 0x8000000000000000ULL;
+}
+
+double radixKeyToDouble( uint64_t key ){
+    double d;
+    key = (key >> 63) ? key ^ 0x8000000000000000ULL : ~key;
+    memcpy( &d, &key, sizeof(d) );
+    return d;
+}
+
+/* radixSortDoubles and radixSortUniqueDoubles
+ * input: an array of doubles and its length
+ * output: none / the number of unique values
+ *
+ * Sorts the array in ascending order with an LSD radix sort over the bits of the doubles, one byte per pass.
+ * Passes where every key has the same byte are skipped.  The unique version also removes duplicates while
+ * scattering the last pass, leaving the unique values at the front of the array.
+ */
+void radixSortDoubles( double* a, int n ){
+    radixSortImpl( a, n, false );
+}
+
+int radixSortUniqueDoubles( double* a, int n ){
+    return radixSortImpl( a, n, true );
+}
+
+int radixSortImpl( double* a, int n, bool unique ){
+    size_t counts[RADIX_PASSES][RADIX_BUCKETS], start[RADIX_BUCKETS], pos[RADIX_BUCKETS];
+    uint64_t lastKey[RADIX_BUCKETS];
+    uint64_t *keys, *src, *dst, k;
+    bool skip[RADIX_PASSES];
+    int i, b, pass, lastPass, shift;
+
+    if( n <= 1 )
+        return n;
+    keys = (uint64_t*)malloc( 2*(size_t)n*sizeof(uint64_t) );
+    if( keys==NULL ) /* no room for the key buffers, so sort without extra memory */
+        return sortInPlace( a, n, unique );
+
+    /* Convert to keys and count every digit in one pass */
+    memset( counts, 0, sizeof(counts) );
+    for( i=0; i<n; i++ ){
+        k = keys[i] = doubleToRadixKey( a[i] );
+        for( pass=0; pass<RADIX_PASSES; pass++ )
+            counts[pass][ (k >> (pass*RADIX_BITS)) & 0xFF ]++;
+    }
+
+    lastPass = findPassesToRun( counts, keys[0], n, skip );
+    if( lastPass == -1 ){ /* every value is equal */
+        free( keys );
+        return unique ? 1 : n;
+    }
+
+    src = keys;
+    dst = keys + n;
+    for( pass=0; pass<=lastPass; pass++ ){
+        if( skip[pass] )
+            continue;
+        shift = pass*RADIX_BITS;
+        start[0] = 0;
+        for( b=1; b<RADIX_BUCKETS; b++ )
+            start[b] = start[b-1] + counts[pass][b-1];
+        memcpy( pos, start, sizeof(pos) );
+
+        if( pass < lastPass ){
+            for( i=0; i<n; i++ ){
+                k = src[i];
+                dst[ pos[ (k >> shift) & 0xFF ]++ ] = k;
+            }
+            uint64_t *swap = src;
+            src = dst;
+            dst = swap;
+        }
+        else{
+            /* Final scatter straight back into a.  Equal keys reach a bucket one after another, so a
+             * duplicate only has to be compared against the previous key placed in its bucket. */
+            for( i=0; i<n; i++ ){
+                k = src[i];
+                b = (k >> shift) & 0xFF;
+                if( unique && pos[b]>start[b] && lastKey[b]==k )
+                    continue;
+                lastKey[b] = k;
+                a[ pos[b]++ ] = radixKeyToDouble( k );
+            }
+        }
+    }
+    free( keys );
+
+    return unique ? compactBuckets( a, start, pos ) : n;
+}
+
+/* radixSortDoublesParallel and radixSortUniqueDoublesParallel
+ * input: an array of doubles, its length and the number of threads to use
+ * output: none / the number of unique values
+ *
+ * Same as radixSortDoubles, but every pass is split across numThreads threads: each thread counts its own
+ * slice, the per-thread counts are turned into disjoint scatter ranges, and each thread scatters its slice.
+ * Duplicates are removed with one linear pass after the sort.
+ */
+void radixSortDoublesParallel( double* a, int n, int numThreads ){
+    radixSortParallelImpl( a, n, numThreads, false );
+}
+
+int radixSortUniqueDoublesParallel( double* a, int n, int numThreads ){
+    return radixSortParallelImpl( a, n, numThreads, true );
+}
+
+int radixSortParallelImpl( double* a, int n, int numThreads, bool unique ){
+    RadixShared sh;
+    RadixThreadArgs *args;
+    pthread_t *threads;
+    int t, i, j;
+
+    if( numThreads <= 1 || n < numThreads*RADIX_BUCKETS )
+        return radixSortImpl( a, n, unique );
+
+    sh.a = a;
+    sh.n = n;
+    sh.numThreads = numThreads;
+    sh.keys = (uint64_t*)malloc( 2*(size_t)n*sizeof(uint64_t) );
+    sh.hist = malloc( numThreads*sizeof(*sh.hist) );
+    sh.offsets = malloc( numThreads*sizeof(*sh.offsets) );
+    args = (RadixThreadArgs*)malloc( numThreads*sizeof(RadixThreadArgs) );
+    threads = (pthread_t*)malloc( numThreads*sizeof(pthread_t) );
+    if( sh.keys==NULL || sh.hist==NULL || sh.offsets==NULL || args==NULL || threads==NULL ){
+        free( threads );
+        free( args );
+        free( sh.offsets );
+        free( sh.hist );
+        free( sh.keys );
+        return radixSortImpl( a, n, unique );
+    }
+    sh.tmp = sh.keys + n;
+    pthread_mutex_init( &sh.startLock, NULL );
+    pthread_cond_init( &sh.startCond, NULL );
+    sh.started = false;
+
+    /* Workers only start once the number of threads is known, so a failed pthread_create just means fewer slices */
+    for( t=0; t<numThreads; t++ ){
+        args[t].sh = &sh;
+        args[t].id = t;
+        if( pthread_create( &threads[t], NULL, radixSortWorker, &args[t] )!=0 )
+            break;
+    }
+    sh.numThreads = t;
+    if( t > 0 ){
+        for( t=0; t<sh.numThreads; t++ ){
+            args[t].begin = (int)((long long)n*t/sh.numThreads);
+            args[t].end = (int)((long long)n*(t+1)/sh.numThreads);
+        }
+        pthread_barrier_init( &sh.barrier, NULL, sh.numThreads );
+    }
+    pthread_mutex_lock( &sh.startLock );
+    sh.started = true;
+    pthread_cond_broadcast( &sh.startCond );
+    pthread_mutex_unlock( &sh.startLock );
+    for( t=0; t<sh.numThreads; t++ )
+        pthread_join( threads[t], NULL );
+
+    if( sh.numThreads > 0 )
+        pthread_barrier_destroy( &sh.barrier );
+    pthread_cond_destroy( &sh.startCond );
+    pthread_mutex_destroy( &sh.startLock );
+    free( threads );
+    free( args );
+    free( sh.offsets );
+    free( sh.hist );
+    free( sh.keys );
+
+    if( sh.numThreads == 0 ) /* no thread could be created */
+        return radixSortImpl( a, n, unique );
+    if( sh.lastPass == -1 )
+        return unique ? 1 : n;
+    if( !unique )
+        return n;
+    for( i=1, j=0; i<n; i++ ){
+        if( a[i]!=a[j] )
+            a[++j] = a[i];
+    }
+    return j+1;
+}
+
+/* radixSortWorker
+ * input: a pointer to a RadixThreadArgs
+ * output: NULL
+ *
+ * Runs one thread's share of every pass of the parallel radix sort
+ */
+void *radixSortWorker( void *arg ){
+    RadixThreadArgs *args = (RadixThreadArgs*)arg;
+    RadixShared *sh = args->sh;
+    size_t (*hist)[RADIX_BUCKETS] = sh->hist[args->id];
+    size_t *pos = sh->offsets[args->id];
+    uint64_t *src = sh->keys, *dst = sh->tmp, *swap, k;
+    int i, b, t, pass, shift;
+
+    pthread_mutex_lock( &sh->startLock );
+    while( !sh->started )
+        pthread_cond_wait( &sh->startCond, &sh->startLock );
+    pthread_mutex_unlock( &sh->startLock );
+
+    /* Convert this slice to keys and count every digit */
+    memset( hist, 0, sizeof(sh->hist[0]) );
+    for( i=args->begin; i<args->end; i++ ){
+        k = src[i] = doubleToRadixKey( sh->a[i] );
+        for( pass=0; pass<RADIX_PASSES; pass++ )
+            hist[pass][ (k >> (pass*RADIX_BITS)) & 0xFF ]++;
+    }
+    pthread_barrier_wait( &sh->barrier );
+
+    if( args->id == 0 ){
+        size_t total[RADIX_PASSES][RADIX_BUCKETS];
+        memset( total, 0, sizeof(total) );
+        for( t=0; t<sh->numThreads; t++ )
+            for( pass=0; pass<RADIX_PASSES; pass++ )
+                for( b=0; b<RADIX_BUCKETS; b++ )
+                    total[pass][b] += sh->hist[t][pass][b];
+        sh->lastPass = findPassesToRun( total, src[0], sh->n, sh->skip );
+    }
+    pthread_barrier_wait( &sh->barrier );
+
+    for( pass=0; pass<=sh->lastPass; pass++ ){
+        if( sh->skip[pass] )
+            continue;
+        shift = pass*RADIX_BITS;
+
+        /* Recount this thread's slice, which changes after every scatter */
+        memset( hist[pass], 0, sizeof(hist[pass]) );
+        for( i=args->begin; i<args->end; i++ )
+            hist[pass][ (src[i] >> shift) & 0xFF ]++;
+        pthread_barrier_wait( &sh->barrier );
+
+        /* Bucket-major, thread-minor prefix sum gives each thread a disjoint range per bucket */
+        if( args->id == 0 ){
+            size_t sum = 0;
+            for( b=0; b<RADIX_BUCKETS; b++ ){
+                for( t=0; t<sh->numThreads; t++ ){
+                    sh->offsets[t][b] = sum;
+                    sum += sh->hist[t][pass][b];
+                }
+            }
+        }
+        pthread_barrier_wait( &sh->barrier );
+
+        if( pass < sh->lastPass ){
+            for( i=args->begin; i<args->end; i++ ){
+                k = src[i];
+                dst[ pos[ (k >> shift) & 0xFF ]++ ] = k;
+            }
+        }
+        else{
+            for( i=args->begin; i<args->end; i++ ){
+                k = src[i];
+                sh->a[ pos[ (k >> shift) & 0xFF ]++ ] = radixKeyToDouble( k );
+            }
+        }
+        pthread_barrier_wait( &sh->barrier );
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    return NULL;
+}
+
+/* sortDoubles and sortUniqueDoubles
+ * input: an array of doubles, its length and the most threads to use
+ * output: none / the number of unique values
+ *
+ * Sorts with the parallel radix sort for arrays of at least RADIX_PARALLEL_THRESHOLD values when more than one
+ * thread may be used, and with the serial one otherwise
+ */
+void sortDoubles( double* a, int n, int numThreads ){
+    if( n >= RADIX_PARALLEL_THRESHOLD )
+        radixSortDoublesParallel( a, n, numThreads );
+    else
+        radixSortDoubles( a, n );
+}
+
+int sortUniqueDoubles( double* a, int n, int numThreads ){
+    if( n >= RADIX_PARALLEL_THRESHOLD )
+        return radixSortUniqueDoublesParallel( a, n, numThreads );
+    return radixSortUniqueDoubles( a, n );
+}
+
+/* findPassesToRun
+ * input: the digit counts for every pass, any one of the keys, the number of keys, and an array to mark skipped passes
+ * output: the last pass that has to run, or -1 if every key is equal
+ *
+ * A pass can be skipped when all n keys share the same digit in it
+ */
+int findPassesToRun( size_t counts[RADIX_PASSES][RADIX_BUCKETS], uint64_t firstKey, int n, bool skip[RADIX_PASSES] ){
+    int pass, lastPass = -1;
+    for( pass=0; pass<RADIX_PASSES; pass++ ){
+        skip[pass] = counts[pass][ (firstKey >> (pass*RADIX_BITS)) & 0xFF ] == (size_t)n;
+        if( !skip[pass] )
+            lastPass = pass;
+    }
+    return lastPass;
+}
+
+/* compactBuckets
+ * input: an array of doubles, and the first index and one past the last used index of each bucket
+ * output: the number of values kept
+ *
+ * Closes the gaps left at the end of each bucket by the duplicates skipped in the final scatter
+ */
+int compactBuckets( double* a, size_t start[RADIX_BUCKETS], size_t end[RADIX_BUCKETS] ){
+    size_t m = 0;
+    int b;
+    for( b=0; b<RADIX_BUCKETS; b++ ){
+        if( start[b]!=m )
+            memmove( a+m, a+start[b], (end[b]-start[b])*sizeof(double) );
+        m += end[b]-start[b];
+    }
+    return (int)m;
+}
+
+/* sortInPlace
+ * input: an array of doubles, its length, and whether to remove duplicates
+ * output: the number of values kept
+ *
+ * Fallback used when the radix sort cannot allocate its buffers
+ */
+int sortInPlace( double* a, int n, bool unique ){
+    int i, j;
+    qsort( a, n, sizeof(double), compareDoubles );
+    if( !unique || n == 0 )
+        return n;
+    for( i=1, j=0; i<n; i++ ){
+        if( a[i]!=a[j] )
+            a[++j] = a[i];
+    }
+    return j+1;
+}
+
+int compareDoubles( const void* a, const void* b ){
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* getNumCPUs
+ * input: none
+ * output: an int
+ *
+ * Returns the number of online CPUs (at least 1)
+ */
+int getNumCPUs( ){
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    return cpus > 0 ? (int)cpus : 1;
+}
@@ -0,0 +1,25 @@
+#ifndef _radixSort_h
+#define _radixSort_h
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Arrays at least this long are sorted with the multi-threaded variant */
+#define RADIX_PARALLEL_THRESHOLD (1<<22)
+
+/**********  Functions for sorting doubles **********/
+void radixSortDoubles( double* a, int n );
+int radixSortUniqueDoubles( double* a, int n );
+void radixSortDoublesParallel( double* a, int n, int numThreads );
+int radixSortUniqueDoublesParallel( double* a, int n, int numThreads );
+int sortUniqueDoubles( double* a, int n, int numThreads );
+void sortDoubles( double* a, int n, int numThreads );
+
+/**********  Functions for converting doubles to sortable keys **********/
+uint64_t doubleToRadixKey( double d );
+double radixKeyToDouble( uint64_t key );
+
+/**********  Functions for choosing thread counts **********/
+int getNumCPUs( );
+
+#endif
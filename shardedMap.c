@@ -0,0 +1,332 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "shardedMap.h"
+
+ShardedMap *allocShardedMap( int numShards, shardMode mode );
+bool insertShardTree( Tree *t, Data *tData );
+Data *searchShardTree( Tree *t, char *key );
+void applyMapOp( Tree *t, MapOp *op );
+void scanTreeRange( TNode *root, char *low, char *high, void (*visit)( Data*, void* ), void *arg );
+uint32_t hashKey( const char *key );
+int compareSplitters( const void *a, const void *b );
+
+/* createShardedMap
+ * input: the number of shards
+ * output: a pointer to a ShardedMap (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates a new empty map whose keys are spread over numShards AVL trees by hash.
+ * A good choice for numShards is a small multiple (2-4) of the number of threads using the map.
+ */
+ShardedMap *createShardedMap( int numShards ){
+    return allocShardedMap( numShards < 1 ? 1 : numShards, SHARD_BY_HASH );
+}
+
+/* createRangeShardedMap
+ * input: an array of splitter keys and its length
+ * output: a pointer to a ShardedMap (this is malloc-ed so must be freed eventually!)
+ *
+ * Creates a new empty map with numSplitters+1 shards, each holding one contiguous range of keys: shard i holds
+ * the keys from splitters[i-1] (inclusive) up to splitters[i] (exclusive).  The splitters are copied and sorted.
+ */
+ShardedMap *createRangeShardedMap( char **splitters, int numSplitters ){
+    int i;
+    ShardedMap *map = allocShardedMap( numSplitters + 1, SHARD_BY_RANGE );
+
+    map->splitters = (char **)malloc( ( numSplitters > 0 ? numSplitters : 1 )*sizeof(char *) );
+    if( map->splitters == NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    for( i=0; i<numSplitters; i++ ){
+        map->splitters[i] = strdup( splitters[i] );
+        if( map->splitters[i] == NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            exit(-1);
+        }
+    }
+    qsort( map->splitters, numSplitters, sizeof(char *), compareSplitters );
+    return map;
+}
+
+ShardedMap *allocShardedMap( int numShards, shardMode mode ){
+    int i;
+    ShardedMap *map = (ShardedMap *)malloc( sizeof(ShardedMap) );
+    if( map == NULL || posix_memalign( (void**)&map->shards, 64, numShards*sizeof(MapShard) ) != 0 ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    map->numShards = numShards;
+    map->mode = mode;
+    map->splitters = NULL;
+
+    for( i=0; i<numShards; i++ ){
+        pthread_rwlock_init( &map->shards[i].lock, NULL );
+        map->shards[i].tree = createTree( );
+        map->shards[i].tree->type = AVL;
+    }
+    return map;
+}
+
+/* freeShardedMap
+ * input: a pointer to a ShardedMap
+ * output: none
+ *
+ * frees the given ShardedMap and all of the Data elements still stored in it
+ */
+void freeShardedMap( ShardedMap *map ){
+    int i;
+    for( i=0; i<map->numShards; i++ ){
+        pthread_rwlock_destroy( &map->shards[i].lock );
+        freeTree( map->shards[i].tree );
+    }
+    if( map->splitters != NULL ){
+        for( i=0; i<map->numShards-1; i++ )
+            free( map->splitters[i] );
+        free( map->splitters );
+    }
+    free( map->shards );
+    free( map );
+}
+
+/* getShardIndex
+ * input: a pointer to a ShardedMap, a key
+ * output: an int
+ *
+ * Returns the index of the shard responsible for key
+ */
+int getShardIndex( ShardedMap *map, const char *key ){
+    int lo = 0, hi = map->numShards-1, mid;
+
+    if( map->mode == SHARD_BY_HASH )
+        return hashKey( key ) % map->numShards;
+
+    /* count the splitters that are <= key */
+    while( lo < hi ){
+        mid = lo + (hi - lo)/2;
+        if( strcmp( map->splitters[mid], key ) <= 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* insertShardedMap
+ * input: a pointer to a ShardedMap, a Data*
+ * output: a boolean
+ *
+ * Stores tData in its shard and returns TRUE, or returns FALSE (leaving tData with the caller) if its key is
+ * already in the map.  Once stored, tData belongs to the map.
+ */
+bool insertShardedMap( ShardedMap *map, Data *tData ){
+    bool inserted;
+    MapShard *shard = &map->shards[ getShardIndex( map, tData->key ) ];
+
+    pthread_rwlock_wrlock( &shard->lock );
+    inserted = insertShardTree( shard->tree, tData );
+    pthread_rwlock_unlock( &shard->lock );
+    return inserted;
+}
+
+/* searchShardedMap
+ * input: a pointer to a ShardedMap, a key
+ * output: a Data*
+ *
+ * Returns the Data stored under key, or NULL if there is none.  The Data stays valid until it is removed.
+ */
+Data *searchShardedMap( ShardedMap *map, char *key ){
+    Data *found;
+    MapShard *shard = &map->shards[ getShardIndex( map, key ) ];
+
+    pthread_rwlock_rdlock( &shard->lock );
+    found = searchShardTree( shard->tree, key );
+    pthread_rwlock_unlock( &shard->lock );
+    return found;
+}
+
+/* removeShardedMap
+ * input: a pointer to a ShardedMap, a key
+ * output: a Data*
+ *
+ * Removes and returns the Data stored under key (which then belongs to the caller), or NULL if there is none
+ */
+Data *removeShardedMap( ShardedMap *map, char *key ){
+    Data *removed;
+    MapShard *shard = &map->shards[ getShardIndex( map, key ) ];
+
+    pthread_rwlock_wrlock( &shard->lock );
+    removed = removeTree( shard->tree, key );
+    pthread_rwlock_unlock( &shard->lock );
+    return removed;
+}
+
+/* applyShardedMapBatch
+ * input: a pointer to a ShardedMap, an array of MapOps and its length
+ * output: none
+ *
+ * Applies every operation, filling in its result and ok fields.  The operations are first grouped by shard
+ * with a counting sort, then each shard's lock is taken once for its whole group: a read lock if the group only
+ * searches, a write lock otherwise.  Operations on the same key are applied in their order in the batch.
+ */
+void applyShardedMapBatch( ShardedMap *map, MapOp *ops, int numOps ){
+    int i, s;
+    bool writes;
+    int *shardOf = (int *)malloc( ( numOps > 0 ? numOps : 1 )*sizeof(int) );
+    int *order = (int *)malloc( ( numOps > 0 ? numOps : 1 )*sizeof(int) );
+    int *start = (int *)calloc( map->numShards+1, sizeof(int) );
+
+    if( shardOf == NULL || order == NULL || start == NULL ){
+        /* no room to group the batch, so lock once per operation instead */
+        for( i=0; i<numOps; i++ ){
+            MapShard *shard = &map->shards[ getShardIndex( map, ops[i].type == MAP_INSERT ? ops[i].data->key : ops[i].key ) ];
+            if( ops[i].type == MAP_SEARCH )
+                pthread_rwlock_rdlock( &shard->lock );
+            else
+                pthread_rwlock_wrlock( &shard->lock );
+            applyMapOp( shard->tree, &ops[i] );
+            pthread_rwlock_unlock( &shard->lock );
+        }
+        free( shardOf );
+        free( order );
+        free( start );
+        return;
+    }
+
+    /* stable counting sort of the operations by shard */
+    for( i=0; i<numOps; i++ ){
+        shardOf[i] = getShardIndex( map, ops[i].type == MAP_INSERT ? ops[i].data->key : ops[i].key );
+        start[ shardOf[i]+1 ]++;
+    }
+    for( s=0; s<map->numShards; s++ )
+        start[s+1] += start[s];
+    for( i=0; i<numOps; i++ )
+        order[ start[ shardOf[i] ]++ ] = i;
+    for( s=map->numShards; s>0; s-- )
+        start[s] = start[s-1];
+    start[0] = 0;
+
+    for( s=0; s<map->numShards; s++ ){
+        if( start[s] == start[s+1] )
+            continue;
+        writes = false;
+        for( i=start[s]; i<start[s+1] && !writes; i++ )
+            writes = ops[ order[i] ].type != MAP_SEARCH;
+
+        if( writes )
+            pthread_rwlock_wrlock( &map->shards[s].lock );
+        else
+            pthread_rwlock_rdlock( &map->shards[s].lock );
+        for( i=start[s]; i<start[s+1]; i++ )
+            applyMapOp( map->shards[s].tree, &ops[ order[i] ] );
+        pthread_rwlock_unlock( &map->shards[s].lock );
+    }
+
+    free( shardOf );
+    free( order );
+    free( start );
+}
+
+/* rangeScanShardedMap
+ * input: a pointer to a ShardedMap, the lowest and highest keys to visit (NULL for no bound), a callback and its argument
+ * output: none
+ *
+ * Calls visit on every Data whose key lies in [low, high], holding the read lock of one shard at a time.
+ * With SHARD_BY_RANGE only the overlapping shards are visited and the keys arrive in sorted order; with
+ * SHARD_BY_HASH every shard is visited and the keys are only sorted within each shard.
+ */
+void rangeScanShardedMap( ShardedMap *map, char *low, char *high, void (*visit)( Data*, void* ), void *arg ){
+    int s, first = 0, last = map->numShards-1;
+
+    if( map->mode == SHARD_BY_RANGE ){
+        if( low != NULL )
+            first = getShardIndex( map, low );
+        if( high != NULL )
+            last = getShardIndex( map, high );
+    }
+    for( s=first; s<=last; s++ ){
+        pthread_rwlock_rdlock( &map->shards[s].lock );
+        scanTreeRange( map->shards[s].tree->root, low, high, visit, arg );
+        pthread_rwlock_unlock( &map->shards[s].lock );
+    }
+}
+
+
+/**********  Helper functions for the shards **********/
+
+/* insertShardTree, searchShardTree and applyMapOp
+ * input: a pointer to a shard's Tree and the operation to perform on it
+ *
+ * Perform one operation on a single tree; the caller must already hold the shard's lock
+ */
+bool insertShardTree( Tree *t, Data *tData ){
+    if( !searchTree( t, tData )->leaf )
+        return false;   /* key already present */
+    insertTreeBalanced( t, tData );
+    return true;
+}
+
+Data *searchShardTree( Tree *t, char *key ){
+    Data temp;
+    TNode *found;
+
+    temp.key = key;
+    found = searchTree( t, &temp );
+    return found->leaf ? NULL : found->data;
+}
+
+void applyMapOp( Tree *t, MapOp *op ){
+    if( op->type == MAP_INSERT ){
+        op->result = NULL;
+        op->ok = insertShardTree( t, op->data );
+    }
+    else if( op->type == MAP_SEARCH ){
+        op->result = searchShardTree( t, op->key );
+        op->ok = op->result != NULL;
+    }
+    else{
+        op->result = removeTree( t, op->key );
+        op->ok = op->result != NULL;
+    }
+}
+
+/* scanTreeRange
+ * input: the root of an AVL tree, the lowest and highest keys to visit (NULL for no bound), a callback and its argument
+ * output: none
+ *
+ * In-order traversal that skips the subtrees lying entirely outside [low, high]
+ */
+void scanTreeRange( TNode *root, char *low, char *high, void (*visit)( Data*, void* ), void *arg ){
+    bool aboveLow, belowHigh;
+
+    if( root->leaf )
+        return;
+    aboveLow = low == NULL || strcmp( root->data->key, low ) >= 0;
+    belowHigh = high == NULL || strcmp( root->data->key, high ) <= 0;
+
+    if( aboveLow )
+        scanTreeRange( root->pLeft, low, high, visit, arg );
+    if( aboveLow && belowHigh )
+        visit( root->data, arg );
+    if( belowHigh )
+        scanTreeRange( root->pRight, low, high, visit, arg );
+}
+
+/* hashKey
+ * input: a key
+ * output: a 32-bit hash
+ *
+ * FNV-1a hash of the key's characters
+ */
+uint32_t hashKey( const char *key ){
+    uint32_t h = 2166136261u;
+    for( ; *key; key++ ){
+        h ^= (unsigned char)*key;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int compareSplitters( const void *a, const void *b ){
+    return strcmp( *(char * const *)a, *(char * const *)b );
+}
@@ -0,0 +1,56 @@
+#ifndef _shardedMap_h
+#define _shardedMap_h
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tree.h"
+#include "data.h"
+
+/* How keys are assigned to shards: by a hash of the key, or by sorted splitter keys so that every shard holds
+ * one contiguous key range and range scans only visit the shards they overlap */
+typedef enum shardMode{ SHARD_BY_HASH, SHARD_BY_RANGE } shardMode;
+
+/*
+ * One independent AVL tree of the ShardedMap.  Each shard is padded out to its own cache line so that
+ * threads working on different shards do not contend on the same line.
+ */
+typedef struct MapShard
+{
+    pthread_rwlock_t lock;      /* protects tree */
+    Tree *tree;                 /* AVL tree holding this shard's keys */
+} __attribute__((aligned(64))) MapShard;
+
+typedef struct ShardedMap
+{
+    MapShard *shards;       /* array of independent trees */
+    int numShards;          /* number of trees */
+    shardMode mode;
+    char **splitters;       /* SHARD_BY_RANGE only: shard i holds the keys in [splitters[i-1], splitters[i]) */
+} ShardedMap;
+
+/* Kinds of operation accepted by applyShardedMapBatch */
+typedef enum mapOpType{ MAP_SEARCH, MAP_INSERT, MAP_REMOVE } mapOpType;
+
+/* One operation of a batch.  MAP_INSERT reads data, the other operations read key. */
+typedef struct MapOp
+{
+    mapOpType type;
+    char *key;
+    Data *data;
+    Data *result;           /* MAP_SEARCH: the Data found, MAP_REMOVE: the Data removed, MAP_INSERT: unused */
+    bool ok;                /* TRUE if the key was found (search/remove) or the data was inserted */
+} MapOp;
+
+ShardedMap *createShardedMap( int numShards );
+ShardedMap *createRangeShardedMap( char **splitters, int numSplitters );
+void freeShardedMap( ShardedMap *map );
+
+int getShardIndex( ShardedMap *map, const char *key );
+bool insertShardedMap( ShardedMap *map, Data *tData );
+Data *searchShardedMap( ShardedMap *map, char *key );
+Data *removeShardedMap( ShardedMap *map, char *key );
+void applyShardedMapBatch( ShardedMap *map, MapOp *ops, int numOps );
+void rangeScanShardedMap( ShardedMap *map, char *low, char *high, void (*visit)( Data*, void* ), void *arg );
+
+#endif
@@ -0,0 +1,478 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "stream.h"
+#include "loader.h"
+#include "radixSort.h"
+
+/* Reads the moves of a text or binary CTP file a chunk at a time */
+typedef struct MoveReader
+{
+    FILE *file;
+    bool binary;
+    long long remaining;        /* moves still to be read */
+    char *buf;                  /* text read buffer */
+    size_t pos, len;            /* unparsed part of buf */
+    bool eof;
+} MoveReader;
+
+/* Position and length (in doubles) of one sorted run in a spill file */
+typedef struct RunInfo
+{
+    long offset;
+    size_t length;
+} RunInfo;
+
+/* Buffered reader over one sorted run */
+typedef struct RunReader
+{
+    long offset;                /* file offset of the next unread double */
+    size_t remaining;           /* doubles of the run not yet read into buf */
+    double *buf;
+    size_t capacity;            /* length of buf */
+    size_t pos, len;            /* next value and number of valid values in buf */
+} RunReader;
+
+/* k-way merge of the sorted runs in one spill file */
+typedef struct MergeStream
+{
+    FILE *file;
+    RunReader *runs;
+    int *heap;                  /* min-heap of run indices ordered by their current value */
+    int heapSize;
+    bool failed;                /* a run could not be read, so the merged stream is incomplete */
+} MergeStream;
+
+bool openMoveReader( MoveReader* r, char* fileName, int* pnumMoves, int* pprovidedSolution );
+int readMovesChunk( MoveReader* r, double* out, int max );
+void closeMoveReader( MoveReader* r );
+bool spillRun( FILE* file, double* values, int n, RunInfo** pruns, int* pnumRuns );
+bool openMergeStream( MergeStream* m, FILE* file, RunInfo* runs, int numRuns, size_t bufferLength );
+bool nextMergeStream( MergeStream* m, double* value );
+bool refillRun( MergeStream* m, int run );
+double peekRun( MergeStream* m, int run );
+void siftDownMerge( MergeStream* m, int i );
+void closeMergeStream( MergeStream* m, int numRuns );
+
+/**********  Functions for solving the CTP out of core **********/
+
+/* carTraversalStream
+ * input: a CTP file name, a memory budget in bytes, and pointers to store the answer and the provided solution in
+ * output: a boolean
+ *
+ * Solves the CTP like carTraversalSweep without ever holding the whole route in memory.  Moves are read in chunks;
+ * whenever the budget is used up the buffered segment starts and ends are sorted and spilled as runs to two
+ * temporary files.  The runs of each file are then k-way merged and fed straight into the sweep.  Routes that fit
+ * in the budget are solved without touching the disk.  Returns FALSE (after printing why) on any error, including
+ * a run that cannot be read back while merging.
+ */
+bool carTraversalStream( char* fileName, size_t memoryBudget, int* presult, int* pprovidedSolution ){
+    MoveReader reader;
+    MergeStream startStream, endStream;
+    RunInfo *startRuns = NULL, *endRuns = NULL;
+    int numStartRuns = 0, numEndRuns = 0, numMoves, capacity, count = 0, buffered = 0, i, j, cur = 0, max = 0;
+    double *moves, *starts, *ends, position = 0, next, start, end;
+    FILE *startFile = NULL, *endFile = NULL;
+    bool ok = true, haveEnd;
+    size_t bufferLength;
+
+    if( !openMoveReader( &reader, fileName, &numMoves, pprovidedSolution ) )
+        return false;
+
+    capacity = (int)( memoryBudget / STREAM_BYTES_PER_MOVE );
+    if( capacity > numMoves )
+        capacity = numMoves;
+    if( capacity < 1 )
+        capacity = 1;
+    moves = (double*)malloc( capacity*sizeof(double) );
+    starts = (double*)malloc( capacity*sizeof(double) );
+    ends = (double*)malloc( capacity*sizeof(double) );
+    if( moves==NULL || starts==NULL || ends==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        ok = false;
+    }
+
+    /* read the route in chunks, spilling sorted runs whenever the buffers fill */
+    while( ok && ( count = readMovesChunk( &reader, moves, capacity - buffered ) ) > 0 ){
+        for( i=0; i<count; i++ ){
+            next = position + moves[i];
+            starts[buffered] = position < next ? position : next;
+            ends[buffered] = position < next ? next : position;
+            buffered++;
+            position = next;
+        }
+        if( buffered == capacity && reader.remaining > 0 ){
+            if( startFile == NULL ){
+                startFile = tmpfile( );
+                endFile = tmpfile( );
+            }
+            sortDoubles( starts, buffered, getNumCPUs( ) );
+            sortDoubles( ends, buffered, getNumCPUs( ) );
+            ok = startFile!=NULL && endFile!=NULL &&
+                 spillRun( startFile, starts, buffered, &startRuns, &numStartRuns ) &&
+                 spillRun( endFile, ends, buffered, &endRuns, &numEndRuns );
+            if( !ok )
+                fprintf( stderr, "%s: failed to write temporary runs\n", fileName );
+            buffered = 0;
+        }
+    }
+    if( count < 0 )
+        ok = false;
+    closeMoveReader( &reader );
+    free( moves );
+
+    if( ok && startFile == NULL ){
+        /* everything fit in the budget: sweep the buffers directly */
+        sortDoubles( starts, buffered, getNumCPUs( ) );
+        sortDoubles( ends, buffered, getNumCPUs( ) );
+        for( i=0, j=0; i<buffered; ){
+            if( starts[i] <= ends[j] ){
+                if( ++cur > max )
+                    max = cur;
+                i++;
+            }
+            else{
+                cur--;
+                j++;
+            }
+        }
+    }
+    else if( ok ){
+        /* spill the last partial run and release the buffers before merging */
+        if( buffered > 0 ){
+            sortDoubles( starts, buffered, getNumCPUs( ) );
+            sortDoubles( ends, buffered, getNumCPUs( ) );
+            ok = spillRun( startFile, starts, buffered, &startRuns, &numStartRuns ) &&
+                 spillRun( endFile, ends, buffered, &endRuns, &numEndRuns );
+        }
+        free( starts );
+        free( ends );
+        starts = ends = NULL;
+
+        /* split the budget between the read buffers of every run */
+        bufferLength = memoryBudget / ( 2*numStartRuns*sizeof(double) );
+        if( bufferLength < STREAM_MIN_MERGE_BUFFER )
+            bufferLength = STREAM_MIN_MERGE_BUFFER;
+
+        if( ok && openMergeStream( &startStream, startFile, startRuns, numStartRuns, bufferLength ) ){
+            if( openMergeStream( &endStream, endFile, endRuns, numEndRuns, bufferLength ) ){
+                /* every end is preceded by its own start, so the starts run out first */
+                haveEnd = nextMergeStream( &endStream, &end );
+                while( !startStream.failed && !endStream.failed && nextMergeStream( &startStream, &start ) ){
+                    while( haveEnd && end < start ){
+                        cur--;
+                        haveEnd = nextMergeStream( &endStream, &end );
+                    }
+                    if( ++cur > max )
+                        max = cur;
+                }
+                if( startStream.failed || endStream.failed )
+                    ok = false;
+                closeMergeStream( &endStream, numEndRuns );
+            }
+            else
+                ok = false;
+            closeMergeStream( &startStream, numStartRuns );
+        }
+        else
+            ok = false;
+        if( !ok )
+            fprintf( stderr, "%s: failed to merge temporary runs\n", fileName );
+    }
+
+    free( starts );
+    free( ends );
+    free( startRuns );
+    free( endRuns );
+    if( startFile != NULL )
+        fclose( startFile );
+    if( endFile != NULL )
+        fclose( endFile );
+
+    *presult = max;
+    return ok;
+}
+
+
+/**********  Functions for reading moves in chunks **********/
+
+/* openMoveReader
+ * input: a MoveReader, a file name, and pointers to store the number of moves and the provided solution in
+ * output: a boolean
+ *
+ * Opens a text or binary CTP file and reads its header.  Returns FALSE if the number of moves is negative or does
+ * not fit in an int32.
+ */
+bool openMoveReader( MoveReader* r, char* fileName, int* pnumMoves, int* pprovidedSolution ){
+    char magic[8];
+    int64_t header[2];
+    long long numMoves, providedSolution;
+
+    memset( r, 0, sizeof(MoveReader) );
+    r->file = fopen( fileName, "rb" );
+    if( r->file == NULL ){
+        fprintf( stderr, "File %s not found.\n", fileName );
+        return false;
+    }
+
+    if( fread( magic, 1, sizeof(magic), r->file ) == sizeof(magic) && memcmp( magic, CTP_BINARY_MAGIC, sizeof(magic) )==0 ){
+        r->binary = true;
+        if( fread( header, sizeof(int64_t), 2, r->file ) != 2 ){
+            fprintf( stderr, "%s: invalid binary CTP file.\n", fileName );
+            fclose( r->file );
+            return false;
+        }
+        if( !isLittleEndian( ) ){
+            swapBytes( &header[0], sizeof(int64_t) );
+            swapBytes( &header[1], sizeof(int64_t) );
+        }
+    }
+    else{
+        rewind( r->file );
+        if( fscanf( r->file, "%lld%lld", &numMoves, &providedSolution ) != 2 ){
+            fprintf( stderr, "%s: invalid file format.  First line should be number of moves followed by the correct solution (or -1 if none is provided)\n", fileName );
+            fclose( r->file );
+            return false;
+        }
+        r->buf = (char*)malloc( STREAM_READ_BLOCK );
+        if( r->buf == NULL ){
+            fprintf( stderr, "malloc failed\n" );
+            fclose( r->file );
+            return false;
+        }
+        header[0] = numMoves;
+        header[1] = providedSolution;
+    }
+    if( header[0] < 0 || header[0] > INT32_MAX ){
+        fprintf( stderr, "%s: the number of moves must be between 0 and %d.\n", fileName, INT32_MAX );
+        closeMoveReader( r );
+        return false;
+    }
+    *pnumMoves = (int)header[0];
+    *pprovidedSolution = (int)header[1];
+    r->remaining = *pnumMoves;
+    return true;
+}
+
+/* readMovesChunk
+ * input: a MoveReader, an array to store moves in, and its length
+ * output: the number of moves read (0 once every move has been read, -1 on an error)
+ *
+ * Reads up to max moves.  Text is read in STREAM_READ_BLOCK blocks; a number cut by the end of a block is
+ * moved to the front of the buffer and completed by the next block.
+ */
+int readMovesChunk( MoveReader* r, double* out, int max ){
+    int n = 0, k;
+    size_t got, e;
+
+    if( r->binary ){
+        k = max < r->remaining ? max : (int)r->remaining;
+        if( k > 0 && fread( out, sizeof(double), k, r->file ) != (size_t)k ){
+            fprintf( stderr, "Failed to read the move sequence\n" );
+            return -1;
+        }
+        if( !isLittleEndian( ) )
+            for( n=0; n<k; n++ )
+                swapBytes( &out[n], sizeof(double) );
+        r->remaining -= k;
+        return k;
+    }
+
+    while( n < max && r->remaining > 0 ){
+        while( r->pos < r->len && isSpace( r->buf[r->pos] ) )
+            r->pos++;
+        e = r->pos;
+        while( e < r->len && !isSpace( r->buf[e] ) )
+            e++;
+        if( e == r->len && !r->eof ){
+            /* the buffer ends inside (or before) a number: keep the partial number and read more */
+            memmove( r->buf, r->buf + r->pos, r->len - r->pos );
+            r->len -= r->pos;
+            r->pos = 0;
+            got = fread( r->buf + r->len, 1, STREAM_READ_BLOCK - r->len, r->file );
+            r->len += got;
+            if( got == 0 )
+                r->eof = true;
+            if( r->len == STREAM_READ_BLOCK && got == 0 ){
+                fprintf( stderr, "Number too long in the move sequence\n" );
+                return -1;
+            }
+            continue;
+        }
+        if( e == r->pos ){ /* end of file */
+            fprintf( stderr, "Failed to read %lldth double in the move sequence\n", (long long)r->remaining );
+            return -1;
+        }
+        if( parseDouble( r->buf + r->pos, r->buf + e, &out[n] ) != r->buf + e ){
+            fprintf( stderr, "Invalid number in the move sequence\n" );
+            return -1;
+        }
+        r->pos = e;
+        r->remaining--;
+        n++;
+    }
+    return n;
+}
+
+/* closeMoveReader
+ * input: a MoveReader
+ * output: none
+ *
+ * Closes the file and frees the read buffer
+ */
+void closeMoveReader( MoveReader* r ){
+    if( r->file != NULL )
+        fclose( r->file );
+    free( r->buf );
+    r->file = NULL;
+    r->buf = NULL;
+}
+
+
+/**********  Functions for spilling and merging sorted runs **********/
+
+/* spillRun
+ * input: a temporary file, a sorted array of doubles and its length, and the list of runs in the file
+ * output: a boolean
+ *
+ * Appends the array to the file as a new run and records where it is
+ */
+bool spillRun( FILE* file, double* values, int n, RunInfo** pruns, int* pnumRuns ){
+    RunInfo *runs = (RunInfo*)realloc( *pruns, (*pnumRuns + 1)*sizeof(RunInfo) );
+    if( runs == NULL )
+        return false;
+    *pruns = runs;
+    if( fseek( file, 0, SEEK_END ) != 0 )
+        return false;
+    runs[*pnumRuns].offset = ftell( file );
+    runs[*pnumRuns].length = n;
+    (*pnumRuns)++;
+    return fwrite( values, sizeof(double), n, file ) == (size_t)n;
+}
+
+/* openMergeStream
+ * input: a MergeStream, the file holding the runs, the runs, the number of runs, and the read buffer length per run
+ * output: a boolean
+ *
+ * Fills every run's buffer and builds the heap of run heads
+ */
+bool openMergeStream( MergeStream* m, FILE* file, RunInfo* runs, int numRuns, size_t bufferLength ){
+    int i;
+
+    m->file = file;
+    m->heapSize = 0;
+    m->failed = false;
+    m->runs = (RunReader*)calloc( numRuns, sizeof(RunReader) );
+    m->heap = (int*)malloc( numRuns*sizeof(int) );
+    if( m->runs == NULL || m->heap == NULL ){
+        free( m->runs );
+        free( m->heap );
+        return false;
+    }
+    for( i=0; i<numRuns; i++ ){
+        m->runs[i].offset = runs[i].offset;
+        m->runs[i].remaining = runs[i].length;
+        m->runs[i].buf = (double*)malloc( bufferLength*sizeof(double) );
+        m->runs[i].capacity = bufferLength;
+        if( m->runs[i].buf == NULL || !refillRun( m, i ) ){
+            closeMergeStream( m, i+1 );
+            return false;
+        }
+        if( m->runs[i].len > 0 )
+            m->heap[ m->heapSize++ ] = i;
+    }
+    for( i=m->heapSize/2 - 1; i>=0; i-- )
+        siftDownMerge( m, i );
+    return true;
+}
+
+/* nextMergeStream
+ * input: a MergeStream and a pointer to store the next value in
+ * output: a boolean
+ *
+ * Stores the smallest value left in any run and returns TRUE, or returns FALSE once every run is exhausted.
+ * If a run cannot be refilled, failed is set and the stream ends after the value just stored.
+ */
+bool nextMergeStream( MergeStream* m, double* value ){
+    RunReader *run;
+
+    if( m->heapSize == 0 )
+        return false;
+    run = &m->runs[ m->heap[0] ];
+    *value = run->buf[ run->pos++ ];
+    if( run->pos == run->len ){
+        if( !refillRun( m, m->heap[0] ) ){
+            m->failed = true;
+            m->heapSize = 0;
+            return true;
+        }
+        if( run->len == 0 )
+            m->heap[0] = m->heap[ --m->heapSize ];  /* run exhausted */
+    }
+    siftDownMerge( m, 0 );
+    return true;
+}
+
+/* refillRun
+ * input: a MergeStream and a run index
+ * output: a boolean
+ *
+ * Reads the next buffer of the run (len becomes 0 when the run is exhausted).  Returns FALSE on a read error.
+ */
+bool refillRun( MergeStream* m, int run ){
+    RunReader *r = &m->runs[run];
+    size_t k = r->remaining < r->capacity ? r->remaining : r->capacity;
+
+    r->pos = 0;
+    r->len = k;
+    if( k == 0 )
+        return true;
+    if( fseek( m->file, r->offset, SEEK_SET ) != 0 || fread( r->buf, sizeof(double), k, m->file ) != k )
+        return false;
+    r->offset += k*sizeof(double);
+    r->remaining -= k;
+    return true;
+}
+
+/* peekRun and siftDownMerge
+ * input: a MergeStream and a run index / heap index
+ * output: the run's current value / none
+ *
+ * Helpers for the min-heap of run heads
+ */
+double peekRun( MergeStream* m, int run ){
+    return m->runs[run].buf[ m->runs[run].pos ];
+}
+
+void siftDownMerge( MergeStream* m, int i ){
+    int smallest, left, right, tmp;
+    while( true ){
+        smallest = i;
+        left = 2*i + 1;
+        right = 2*i + 2;
+        if( left < m->heapSize && peekRun( m, m->heap[left] ) < peekRun( m, m->heap[smallest] ) )
+            smallest = left;
+        if( right < m->heapSize && peekRun( m, m->heap[right] ) < peekRun( m, m->heap[smallest] ) )
+            smallest = right;
+        if( smallest == i )
+            return;
+        tmp = m->heap[i];
+        m->heap[i] = m->heap[smallest];
+        m->heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+/* closeMergeStream
+ * input: a MergeStream and the number of runs it opened
+ * output: none
+ *
+ * Frees the read buffers and the heap (the file is owned by the caller)
+ */
+void closeMergeStream( MergeStream* m, int numRuns ){
+    int i;
+    for( i=0; i<numRuns; i++ )
+        free( m->runs[i].buf );
+    free( m->runs );
+    free( m->heap );
+}
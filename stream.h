@@ -0,0 +1,23 @@
+#ifndef _stream_h
+#define _stream_h
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Default memory budget for the streaming CTP solver */
+#define STREAM_DEFAULT_BUDGET ((size_t)256 << 20)
+
+/* Bytes of memory needed per buffered move: the move itself, its segment start and end, and the two key
+ * buffers the radix sort allocates while sorting a run */
+#define STREAM_BYTES_PER_MOVE 40
+
+/* Smallest read buffer (in doubles) given to each run while merging */
+#define STREAM_MIN_MERGE_BUFFER 1024
+
+/* Size in bytes of the buffer used to read text move files */
+#define STREAM_READ_BLOCK (1<<20)
+
+/**********  Functions for solving the CTP out of core **********/
+bool carTraversalStream( char* fileName, size_t memoryBudget, int* presult, int* pprovidedSolution );
+
+#endif
@@ -1,7 +1,48 @@
+#include <pthread.h>
+
 #include "tree.h"
+#include "instrument.h"
+
+/* Stores a field of a node linked into a tree.  Lock-free readers (optimisticTree.c) may be loading it at the same
+ * time, so every such store between beginWriteTNode and endWriteTNode, and every store to t->root, goes through here. */
+#define SET_TNODE_FIELD( field, value ) __atomic_store_n( &(field), (value), __ATOMIC_RELEASE )
 
 /**********  Helper functions for removing from an AVL tree **********/
-TNode* removeNextInorder( TNode** pRoot );
+TNode* removeNextInorder( Tree* t, TNode** pRoot );
+void releaseTNode( Tree* t, TNode* node );
+
+/**********  Helper functions for Segment Tree **********/
+void batchStabQueryRec( TNode* root, int acc, double* points, int n, int* out, int* k, int* max );
+void recordStabCount( double point, int count, double* points, int n, int* out, int* k, int* max );
+int lowerBoundPoint( double* points, int n, double x );
+
+/**********  Helper functions for array-backed Segment Tree **********/
+void buildST( SegmentTree* st, int i, int low, int high );
+void insertSTRec( SegmentTree* st, int* cnt, int i, int segmentStart, int segmentEnd );
+void *insertSTWorker( void *arg );
+void *sumCountsSTWorker( void *arg );
+
+typedef struct InsertSTArgs
+{
+    SegmentTree *st;
+    struct InsertSTArgs *all;   /* arguments of every thread, to reach their count arrays */
+    int numThreads;
+    int *cnt;                   /* private count array, one entry per node */
+    int *segmentStarts, *segmentEnds;
+    int begin, end;             /* slice of segments (while inserting) or nodes (while summing) for this thread */
+    bool running;               /* a thread was created for this slice (it ran inline otherwise) */
+} InsertSTArgs;
+void batchStabQuerySTRec( SegmentTree* st, int i, int acc, int* out, int* max );
+
+/**********  Helper functions for dynamic Segment Tree **********/
+void updateDST( DynamicSegmentTree* dst, double segmentStart, double segmentEnd, int delta );
+void updateDSTRec( DynamicSegmentTree* dst, int i, int low, int high, int first, int last, int delta );
+
+/**********  Helper functions for freezing an AVL tree **********/
+int countTNodes( TNode* root );
+void layoutVEB( TNode* root, int levels, TNode** order, int* k );
+void layoutVEBBottoms( TNode* root, int depth, int levels, TNode** order, int* k );
+void freeTNodes( Tree* t, TNode* root );
 
 /**********  Helper functions for balancing an AVL tree **********/
 void updateHeights(TNode* root);
@@ -13,52 +54,84 @@ TNode* getTallerSubTree(TNode* root);
 bool isSameSignBalance(TNode* x, TNode* z);
 int subTreeHeight(TNode* root);
 
-/* createTree
- * input: none
+/* createTree and createTreeWithAllocator
+ * input: none / the Allocator to take the tree's memory from (NULL for malloc/free)
  * output: a pointer to a Tree (this is malloc-ed so must be freed eventually!)
  *
- * Creates a new empty Tree and returns a pointer to it.
+ * Creates a new empty Tree and returns a pointer to it.  The Tree counts the memory it holds in t->mem.
  */
 Tree *createTree( )
 {
-    Tree* t = (Tree*)malloc( sizeof(Tree) );
-    t->root = (TNode*)malloc( sizeof(TNode) );
+    return createTreeWithAllocator( NULL );
+}
+
+Tree *createTreeWithAllocator( Allocator* allocator )
+{
+    MemTracker mem;
+    Tree* t;
+
+    initMemTracker( &mem, allocator );
+    t = (Tree*)trackedAlloc( &mem, sizeof(Tree) );
+    if( t==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    t->mem = mem;
+    t->root = createTNode( t );
 
     t->root->leaf = true;
     t->root->height = 0;
     t->root->pParent = t->root->pLeft = t->root->pRight = NULL;
+    t->retireTNode = NULL;
+    t->retireArg = NULL;
+    t->frozenBytes = 0;
 
     return t;
 }
 
-Tree *createTreeFromTNode( TNode* root )
+/* createTNode and freeTNode
+ * input: a pointer to a Tree (and a node created for it)
+ * output: a new TNode with version 0 / none
+ *
+ * Allocate and free a node from the tree's allocator
+ */
+TNode* createTNode( Tree* t )
 {
-    Tree* t = (Tree*)malloc( sizeof(Tree) );
-    t->root = root;
+    TNode* node = (TNode *)trackedAlloc( &t->mem, sizeof(TNode) );
+    if( node==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        exit(-1);
+    }
+    node->version = 0;
+    return node;
+}
 
-    return t;
+void freeTNode( Tree* t, TNode* node )
+{
+    trackedFree( &t->mem, node, sizeof(TNode) );
 }
 
 /* attachLeafNodes
- * input: a pointer to a TNode
+ * input: a pointer to a Tree, a pointer to a TNode
  * output: none
  *
- * Mallocs and stores leaf nodes below the passed in TNode ins
+ * Allocates and stores leaf nodes below the passed in TNode ins
  */
-void attachLeafNodes( TNode *ins )
+void attachLeafNodes( Tree* t, TNode *ins )
 {
+    TNode *left, *right;
+
     /* Mark this node as not a leaf */
-    ins->leaf = false;
+    SET_TNODE_FIELD( ins->leaf, false );
 
     /* Add empty leaf nodes below this node */
-    ins->pLeft = (TNode *)malloc( sizeof(TNode) );
-    ins->pRight = (TNode *)malloc( sizeof(TNode) );
-    if( ins->pLeft==NULL || ins->pRight==NULL ){
-        fprintf( stderr, "malloc failed\n" );
-        exit(-1);
-    }
-    ins->pLeft->leaf = ins->pRight->leaf = true;
-    ins->pLeft->pParent = ins->pRight->pParent = ins;
+    COUNT_N( CNT_LEAF_ALLOCS, 2 );
+    left = createTNode( t );
+    right = createTNode( t );
+    left->leaf = right->leaf = true;
+    left->pParent = right->pParent = ins;
+    SET_TNODE_FIELD( ins->pLeft, left );
+    SET_TNODE_FIELD( ins->pRight, right );
     ins->pLeft->pLeft = ins->pRight->pLeft = ins->pLeft->pRight = ins->pRight->pRight = NULL;
     ins->pLeft->height = ins->pRight->height = 0;
 }
@@ -76,31 +149,50 @@ void attachChildNodes( TNode* root, TNode* left, TNode* right ){
 }
 
 /* freeTree and freeTreeContents
- * input: a pointer to a Tree
+ * input: a pointer to a Tree (and the root of the subtree to free)
  * output: none
  *
  * frees the given Tree and all of Data elements
  */
 void freeTree( Tree *t )
 {
-    freeTreeContents(t->root, t->type);
-    free(t);
+    MemTracker mem;
+
+    if( t->frozenBytes > 0 )
+        trackedFree( &t->mem, t->root, t->frozenBytes );   /* nodes, Data and keys are all in one block */
+    else
+        freeTreeContents(t, t->root);
+    mem = t->mem;
+    trackedFree( &mem, t, sizeof(Tree) );
 }
 
-void freeTreeContents( TNode *root, treeType type )
+void freeTreeContents( Tree* t, TNode *root )
 {
     if(root==NULL)
         return;
 
-    freeTreeContents(root->pLeft, type);
-    freeTreeContents(root->pRight, type);
+    freeTreeContents(t, root->pLeft);
+    freeTreeContents(t, root->pRight);
     if(root->leaf==false){
-        if(type==AVL && root->data!=NULL)
+        if(t->type==AVL && root->data!=NULL)
             freeData(root->data);
-        if(type==HUFFMAN && root->str!=NULL)
-            free(root->str);
+        if(t->type==HUFFMAN && root->str!=NULL)
+            trackedFree( &t->mem, root->str, strlen(root->str)+1 );
     }
-    free(root);
+    freeTNode(t, root);
+}
+
+/* getTreeMemStats
+ * input: a pointer to a Tree, a pointer to store its MemStats in
+ * output: none
+ *
+ * Reports the memory held by the tree: the Tree itself, every node (leaf sentinels included) and the Huffman str
+ * buffers.  The Data stored in an AVL tree is allocated by the caller and is not counted until freezeTree moves it
+ * into the tree's block.
+ */
+void getTreeMemStats( Tree* t, MemStats* out )
+{
+    *out = t->mem.stats;
 }
 
 
@@ -128,28 +220,97 @@ TNode* searchTreeRec( TNode *root, Data* tData )
         return searchTreeRec( root->pRight, tData );
 }
 
+/* searchTreeBatch
+ * input: a pointer to a Tree, an array of n Data* keys, and an array of n TNode* to store the results in
+ * output: none
+ *
+ * Does searchTree for every key, storing each result in out.  A single search stalls on three dependent cache
+ * misses per level (the node, its Data and the key string), so up to TREE_BATCH_GROUP independent searches are
+ * advanced round-robin, one step each per round: a step prefetches what the search needs next and moves on, so
+ * by the time the search comes round again its memory has usually arrived.
+ */
+void searchTreeBatch( Tree *t, Data** keys, int n, TNode** out )
+{
+    TNode *node[TREE_BATCH_GROUP];
+    int key[TREE_BATCH_GROUP], stage[TREE_BATCH_GROUP];
+    int g, cmp, active = 0, next = 0;
+
+    while( active < TREE_BATCH_GROUP && next < n ){
+        node[active] = t->root;
+        key[active] = next++;
+        stage[active++] = 0;
+    }
+
+    while( active > 0 ){
+        for( g=0; g<active; ){
+            /* stage 0: the node has arrived, fetch its Data */
+            if( stage[g] == 0 && !node[g]->leaf ){
+                __builtin_prefetch( node[g]->data );
+                stage[g] = 1;
+                g++;
+                continue;
+            }
+            /* stage 1: the Data has arrived, fetch its key */
+            if( stage[g] == 1 ){
+                __builtin_prefetch( node[g]->data->key );
+                stage[g] = 2;
+                g++;
+                continue;
+            }
+
+            /* stage 2: compare and either finish or step down to the child */
+            if( node[g]->leaf || ( cmp = compareData( keys[key[g]], node[g]->data ) ) == 0 ){
+                out[key[g]] = node[g];
+                if( next < n ){     /* start the next key in this slot */
+                    node[g] = t->root;
+                    key[g] = next++;
+                    stage[g] = 0;
+                    g++;
+                }
+                else{               /* no keys left, so shrink the group */
+                    active--;
+                    node[g] = node[active];
+                    key[g] = key[active];
+                    stage[g] = stage[active];
+                }
+                continue;
+            }
+            node[g] = cmp < 0 ? node[g]->pLeft : node[g]->pRight;
+            __builtin_prefetch( node[g] );
+            stage[g] = 0;
+            g++;
+        }
+    }
+}
+
 
 /**********  Functions for inserting/removing from an AVL tree **********/
 
 /* insertAtTNode
- * input: a pointer to a TNode, a Data*
+ * input: a pointer to a Tree, a pointer to one of its TNodes, a Data*
  * output: none
  *
  * Stores the passed Data* into the given leaf TNode, Does not rebalance tree
  */
-void insertAtTNode( TNode *ins, Data* tData )
+void insertAtTNode( Tree* t, TNode *ins, Data* tData )
 {
     if( !ins->leaf ){
         fprintf( stderr, "inserting into non-leaf node\n" );
         exit(-1);
     }
+    if( t->frozenBytes > 0 ){
+        fprintf( stderr, "inserting into a frozen tree\n" );
+        exit(-1);
+    }
 
-    attachLeafNodes( ins );
+    beginWriteTNode( ins );
+    attachLeafNodes( t, ins );
     updateHeights( ins );
 
     /* Put data in the node returned by search */
-    ins->data = tData;
-    ins->str = NULL;
+    SET_TNODE_FIELD( ins->data, tData );
+    SET_TNODE_FIELD( ins->str, NULL );
+    endWriteTNode( ins );
 }
 
 /* insertTree
@@ -161,7 +322,7 @@ void insertAtTNode( TNode *ins, Data* tData )
 void insertTree( Tree *t, Data* tData )
 {
     TNode* ins = searchTree( t, tData );
-    insertAtTNode( ins, tData );
+    insertAtTNode( t, ins, tData );
 }
 
 /* insertTreeBalanced
@@ -173,7 +334,7 @@ void insertTree( Tree *t, Data* tData )
 void insertTreeBalanced( Tree *t, Data* tData )
 {
     TNode* ins = searchTree( t, tData );
-    insertAtTNode( ins, tData );
+    insertAtTNode( t, ins, tData );
     rebalanceTree( t, ins );
 }
 
@@ -190,6 +351,10 @@ Data* removeTree( Tree *t, char* key )
     TNode *del, *update;
     TNode **parentDelPtr;
 
+    if( t->frozenBytes > 0 ){
+        fprintf( stderr, "removing from a frozen tree\n" );
+        exit(-1);
+    }
     temp.key = key;
     del = searchTree( t, &temp );
     ret = del->data;
@@ -205,26 +370,56 @@ Data* removeTree( Tree *t, char* key )
 
     /* del has no left child */
     if( del->pLeft->leaf==true ){
-        free( del->pLeft );
-        *parentDelPtr = del->pRight;
-        update = del->pRight->pParent = del->pParent;
-        free( del );
+        beginWriteTNode( del->pParent );
+        beginWriteTNode( del );
+        beginWriteTNode( del->pRight );
+        releaseTNode( t, del->pLeft );
+        SET_TNODE_FIELD( *parentDelPtr, del->pRight );
+        SET_TNODE_FIELD( del->pRight->pParent, del->pParent );
+        update = del->pParent;
+        endWriteTNode( del->pRight );
+        endWriteTNode( del );
+        endWriteTNode( del->pParent );
+        releaseTNode( t, del );
     }
 
     /* del has no right child */
     else if( del->pRight->leaf==true ){
-        free( del->pRight );
-        *parentDelPtr = del->pLeft;
-        update = del->pLeft->pParent = del->pParent;
-        free( del );
+        beginWriteTNode( del->pParent );
+        beginWriteTNode( del );
+        beginWriteTNode( del->pLeft );
+        releaseTNode( t, del->pRight );
+        SET_TNODE_FIELD( *parentDelPtr, del->pLeft );
+        SET_TNODE_FIELD( del->pLeft->pParent, del->pParent );
+        update = del->pParent;
+        endWriteTNode( del->pLeft );
+        endWriteTNode( del );
+        endWriteTNode( del->pParent );
+        releaseTNode( t, del );
     }
 
     /* del has two children */
     else{
-        TNode *next = removeNextInorder( &del->pRight );
+        TNode *next = del->pRight, *nextParent, *nextRight;
+        while( next->pLeft->leaf==false )
+            next = next->pLeft;
+        nextParent = next->pParent;
+        nextRight = next->pRight;
+
+        beginWriteTNode( del );
+        if( nextParent!=del )
+            beginWriteTNode( nextParent );
+        beginWriteTNode( next );
+        beginWriteTNode( nextRight );
+        removeNextInorder( t, &del->pRight );
         update = next->pParent;
-        del->data = next->data;
-        free(next);
+        SET_TNODE_FIELD( del->data, next->data );
+        endWriteTNode( nextRight );
+        endWriteTNode( next );
+        if( nextParent!=del )
+            endWriteTNode( nextParent );
+        endWriteTNode( del );
+        releaseTNode( t, next );
     }
 
     /* Update the heights and rebalance around the node update */
@@ -233,20 +428,33 @@ Data* removeTree( Tree *t, char* key )
     return ret;
 }
 
-TNode* removeNextInorder( TNode** pRoot ){
+TNode* removeNextInorder( Tree* t, TNode** pRoot ){
     TNode* temp = *pRoot;
 
     if( temp->pLeft->leaf == true ){
-        *pRoot = temp->pRight;
-        temp->pRight->pParent = temp->pParent;
-        free( temp->pLeft );
+        SET_TNODE_FIELD( *pRoot, temp->pRight );
+        SET_TNODE_FIELD( temp->pRight->pParent, temp->pParent );
+        releaseTNode( t, temp->pLeft );
     }
     else
-        temp = removeNextInorder( &temp->pLeft );
+        temp = removeNextInorder( t, &temp->pLeft );
 
     return temp;
 }
 
+/* releaseTNode
+ * input: a pointer to a Tree and a TNode removed from it
+ * output: none
+ *
+ * Frees the node, or hands it to the tree's retireTNode callback if it has one
+ */
+void releaseTNode( Tree* t, TNode* node ){
+    if( t->retireTNode!=NULL )
+        t->retireTNode( t->retireArg, node );
+    else
+        freeTNode( t, node );
+}
+
 int subTreeHeight(TNode* root){
     return root->height;
 }
@@ -259,6 +467,7 @@ int subTreeHeight(TNode* root){
  */
 void updateHeights(TNode* root){
     if(root!=NULL){
+        COUNT( CNT_HEIGHT_UPDATES );
         root->height = subTreeHeight(root->pLeft)>subTreeHeight(root->pRight) ? subTreeHeight(root->pLeft) : subTreeHeight(root->pRight);
         root->height = root->height + 1;
         updateHeights( root->pParent );
@@ -302,7 +511,7 @@ void rebalanceTree(Tree* t, TNode* x){
             
             // if x was root before update, update the root to parent of x
             if(t->root == x)
-                t->root = x->pParent;
+                SET_TNODE_FIELD( t->root, x->pParent );
         }
         x = x->pParent;
     }
@@ -330,46 +539,94 @@ bool isSameSignBalance(TNode* x, TNode* z) {
  */
 void rightRotate(TNode* oldRoot){
     TNode *newRoot = oldRoot->pLeft;
+    TNode *parent = oldRoot->pParent, *moved = newRoot->pRight;
+
+    COUNT( CNT_RIGHT_ROTATE );
+
+    beginWriteTNode( parent );
+    beginWriteTNode( oldRoot );
+    beginWriteTNode( newRoot );
+    beginWriteTNode( moved );
 
     if( oldRoot->pParent!=NULL ){
         if( oldRoot->pParent->pLeft==oldRoot )
-            oldRoot->pParent->pLeft = oldRoot->pLeft;
+            SET_TNODE_FIELD( oldRoot->pParent->pLeft, oldRoot->pLeft );
         else
-            oldRoot->pParent->pRight = oldRoot->pLeft;
+            SET_TNODE_FIELD( oldRoot->pParent->pRight, oldRoot->pLeft );
     }
-    newRoot->pParent = oldRoot->pParent;
+    SET_TNODE_FIELD( newRoot->pParent, oldRoot->pParent );
 
-    oldRoot->pLeft = newRoot->pRight;
+    SET_TNODE_FIELD( oldRoot->pLeft, newRoot->pRight );
     if( newRoot->pRight!=NULL )
-        newRoot->pRight->pParent = oldRoot;
+        SET_TNODE_FIELD( newRoot->pRight->pParent, oldRoot );
+
+    SET_TNODE_FIELD( oldRoot->pParent, newRoot );
+    SET_TNODE_FIELD( newRoot->pRight, oldRoot );
 
-    oldRoot->pParent = newRoot;
-    newRoot->pRight = oldRoot;
+    endWriteTNode( moved );
+    endWriteTNode( newRoot );
+    endWriteTNode( oldRoot );
+    endWriteTNode( parent );
 
     updateHeights( oldRoot );
 }
 
 void leftRotate(TNode* oldRoot){
     TNode *newRoot = oldRoot->pRight;
+    TNode *parent = oldRoot->pParent, *moved = newRoot->pLeft;
+
+    COUNT( CNT_LEFT_ROTATE );
+
+    beginWriteTNode( parent );
+    beginWriteTNode( oldRoot );
+    beginWriteTNode( newRoot );
+    beginWriteTNode( moved );
 
     if( oldRoot->pParent!=NULL ){
         if( oldRoot->pParent->pRight==oldRoot )
-            oldRoot->pParent->pRight = oldRoot->pRight;
+            SET_TNODE_FIELD( oldRoot->pParent->pRight, oldRoot->pRight );
         else
-            oldRoot->pParent->pLeft = oldRoot->pRight;
+            SET_TNODE_FIELD( oldRoot->pParent->pLeft, oldRoot->pRight );
     }
-    newRoot->pParent = oldRoot->pParent;
+    SET_TNODE_FIELD( newRoot->pParent, oldRoot->pParent );
 
-    oldRoot->pRight = newRoot->pLeft;
+    SET_TNODE_FIELD( oldRoot->pRight, newRoot->pLeft );
     if( newRoot->pLeft!=NULL )
-        newRoot->pLeft->pParent = oldRoot;
+        SET_TNODE_FIELD( newRoot->pLeft->pParent, oldRoot );
 
-    oldRoot->pParent = newRoot;
-    newRoot->pLeft = oldRoot;
+    SET_TNODE_FIELD( oldRoot->pParent, newRoot );
+    SET_TNODE_FIELD( newRoot->pLeft, oldRoot );
+
+    endWriteTNode( moved );
+    endWriteTNode( newRoot );
+    endWriteTNode( oldRoot );
+    endWriteTNode( parent );
 
     updateHeights( oldRoot );
 }
 
+/**********  Functions for versioning TNodes **********/
+
+/* beginWriteTNode and endWriteTNode
+ * input: a pointer to a TNode (or NULL)
+ * output: none
+ *
+ * Bracket every change to a node's leaf flag, data or links.  The version is odd between the two calls, so a
+ * reader that sees the same even version before and after reading a node knows it read a consistent node.
+ * Each node must be bracketed at most once at a time.
+ */
+void beginWriteTNode( TNode* node ){
+    if( node==NULL )
+        return;
+    __atomic_store_n( &node->version, node->version+1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+void endWriteTNode( TNode* node ){
+    if( node!=NULL )
+        __atomic_store_n( &node->version, node->version+1, __ATOMIC_RELEASE );
+}
+
 /* getBalance
  * input: a pointer to a TNode
  * output: none
@@ -391,38 +648,46 @@ int getBalance(TNode* root){
  * This function prints the Huffman encoding for the char c.  This encoding is based on the given Huffman tree.
  */
 void printHuffmanEncoding( TNode* root, char c ){
-    char *encoding = (char*)malloc(sizeof(char) * 50);
-    char tempstr[2];
-    tempstr[0] = c;
-    tempstr[1] = '\0';
+    char encoding[50];
+    getHuffmanEncoding( root, c, encoding );
+    printf("%s", encoding);
+}
 
-    while(root != NULL) {
-        if(strcmp(tempstr, root->str) == 0)
-            break;
+/* getHuffmanEncoding
+ * input: a pointer to TNode, a char, and a buffer for the encoding (one char per tree level plus one)
+ * output: the length of the encoding
+ *
+ * Stores the Huffman encoding for the char c as a string of '0's and '1's
+ */
+int getHuffmanEncoding( TNode* root, char c, char* encoding ){
+    int length = 0;
 
-        if(strchr(root->pLeft->str, c) != 0) {
-            strcat(encoding, "0");
+    while( root != NULL && !( root->str[0] == c && root->str[1] == '\0' ) ){
+        if( root->pLeft->leaf ) /* c is not in the tree */
+            break;
+        if( strchr( root->pLeft->str, c ) != NULL ){
+            encoding[length++] = '0';
             root = root->pLeft;
         }
         else {
-            strcat(encoding, "1");
+            encoding[length++] = '1';
             root = root->pRight;
         }
     }
-    printf("%s", encoding);
-    free(encoding);
+    encoding[length] = '\0';
+    return length;
 }
 
 /**********  Functions for Segment Tree **********/
 
 /* constructSegmentTree
- * input: an array of doubles, an int low, an int high
+ * input: the Tree to allocate the nodes from, an array of doubles, an int low, an int high
  * output: the root of a tree
  *
  * Recursively builds a balanced tree containing all of the data in array points from index low to index high.
  */
-TNode* constructSegmentTree( double* points, int low, int high ){
-    TNode* root = (TNode*)malloc( sizeof(TNode) );
+TNode* constructSegmentTree( Tree* t, double* points, int low, int high ){
+    TNode* root = createTNode( t );
     root->cnt = 0;
     root->low = points[low];
     root->high = points[high];
@@ -432,9 +697,9 @@ TNode* constructSegmentTree( double* points, int low, int high ){
     /* Recursively split the array around the mid point of the high and low indices */
     int mid = (high - low)/2 + low;
     if( low==high ) /* only one node left in the sub-array */
-        attachLeafNodes( root );
+        attachLeafNodes( t, root );
     else
-        attachChildNodes( root, constructSegmentTree( points, low, mid ), constructSegmentTree( points, mid+1, high ) );
+        attachChildNodes( root, constructSegmentTree( t, points, low, mid ), constructSegmentTree( t, points, mid+1, high ) );
 
     return root;
 }
@@ -443,43 +708,692 @@ TNode* constructSegmentTree( double* points, int low, int high ){
  * input: the root of a tree, a double segmentStart, and a double segmentEnd
  * output: none
  *
- * Recursively inserts the line segment from segmentStart to segmentEnd into the tree
+ * Recursively inserts the closed line segment from segmentStart to segmentEnd into the tree.
+ * The segment is counted at the O(log n) highest nodes whose [low, high] ranges it fully covers.
  */
 void insertSegment( TNode* root, double segmentStart, double segmentEnd ){
-    //TODO
-    if(root->leaf == true)
-        return;
-    else if(segmentStart == root->low || segmentEnd == root->high)
-        return;
-    else if(root->high - root->low < segmentEnd) {
+    COUNT( CNT_SEGMENT_VISITS );
+    if( root->leaf == true || segmentEnd < root->low || segmentStart > root->high )
+        return; /* segment does not overlap this node */
+    else if( segmentStart <= root->low && root->high <= segmentEnd ){
         root->cnt++;
         return;
     }
-    else {
-        insertSegment(root->pLeft, segmentStart, segmentEnd);
-        insertSegment(root->pRight, segmentStart, segmentEnd);
-    }
+    insertSegment( root->pLeft, segmentStart, segmentEnd );
+    insertSegment( root->pRight, segmentStart, segmentEnd );
 }
 
 /* lineStabQuery
  * input: the root of a tree, a double queryPoint
- * output: none
+ * output: the number of line segments which contain queryPoint
  *
- * Recursively count the number of line segments which intersect the queryPoint.
+ * Sums cnt along the single root-to-leaf path of nodes whose [low, high] range contains the queryPoint.
+ * The queryPoint must be one of the points the tree was constructed from.
  */
 int lineStabQuery( TNode* root, double queryPoint ){
-    //TODO
-    if(root->leaf == true)
+    COUNT( CNT_SEGMENT_VISITS );
+    if( root->leaf == true || queryPoint < root->low || queryPoint > root->high )
         return 0;
-    else if(queryPoint == root->low || queryPoint == root->high) {
+    else if( root->pLeft->leaf == true ) /* bottom of the tree */
+        return root->cnt;
+    else if( queryPoint <= root->pLeft->high )
+        return root->cnt + lineStabQuery( root->pLeft, queryPoint );
+    else
+        return root->cnt + lineStabQuery( root->pRight, queryPoint );
+}
+
+/* batchStabQuery
+ * input: the root of a tree, a sorted array of query points, its length n, and an optional int array of length n
+ * output: the largest number of line segments containing any of the points
+ *
+ * Answers lineStabQuery for every point at once with a single in-order traversal that carries the sum of cnt
+ * down to the bottom of the tree, so the upper levels are visited once instead of once per point.
+ * If out is not NULL, out[i] receives the count for points[i].  Points the tree was not built on get 0.
+ */
+int batchStabQuery( TNode* root, double* points, int n, int* out ){
+    int k = 0, max = 0;
+    batchStabQueryRec( root, 0, points, n, out, &k, &max );
+    for( ; k<n; k++ ) /* points past the end of the tree */
+        if( out!=NULL )
+            out[k] = 0;
+    return max;
+}
+
+void batchStabQueryRec( TNode* root, int acc, double* points, int n, int* out, int* k, int* max ){
+    if( root->leaf == true )
+        return;
+    COUNT( CNT_SEGMENT_VISITS );
+    acc += root->cnt;
+    if( root->pLeft->leaf == true ) /* bottom of the tree */
+        recordStabCount( root->low, acc, points, n, out, k, max );
+    else{
+        batchStabQueryRec( root->pLeft, acc, points, n, out, k, max );
+        batchStabQueryRec( root->pRight, acc, points, n, out, k, max );
+    }
+}
+
+/* recordStabCount
+ * input: the point at the bottom of the tree reached in order, its count, and the batchStabQuery state
+ * output: none
+ *
+ * Matches the bottom-level point against the sorted query points and records its count
+ */
+void recordStabCount( double point, int count, double* points, int n, int* out, int* k, int* max ){
+    for( ; *k<n && points[*k]<point; (*k)++ )
+        if( out!=NULL )
+            out[*k] = 0;
+    if( *k<n && points[*k]==point ){
+        if( out!=NULL )
+            out[*k] = count;
+        if( count>*max )
+            *max = count;
+        (*k)++;
+    }
+}
+
+
+
+/**********  Functions for array-backed Segment Tree **********/
+
+/* createST and createSTWithAllocator
+ * input: an array of sorted, unique doubles and its length (and the Allocator to take the tree's memory from, NULL
+ *        for malloc/free)
+ * output: a pointer to a SegmentTree (this is malloc-ed so must be freed eventually!)
+ *
+ * Builds the same balanced tree as constructSegmentTree, but stored implicitly: node i has its children at
+ * 2i+1 and 2i+2, and low, high and cnt live in separate arrays carved out of a single allocation.
+ * The tree works on ranks (indices into points) only; points is kept as a side table and must outlive the tree.
+ * Returns NULL if the tree cannot be allocated.
+ */
+SegmentTree* createST( double* points, int numPoints ){
+    return createSTWithAllocator( points, numPoints, NULL );
+}
+
+SegmentTree* createSTWithAllocator( double* points, int numPoints, Allocator* allocator ){
+    SegmentTree* st;
+    int leaves = 1;
+    size_t arrays;
+    MemTracker mem;
+
+    while( leaves < numPoints )
+        leaves *= 2;
+
+    /* a balanced tree over numPoints leaves never uses an index past 2*leaves-1 */
+    arrays = (2*leaves - 1)*3*sizeof(int);
+    initMemTracker( &mem, allocator );
+    st = (SegmentTree*)trackedAlloc( &mem, sizeof(SegmentTree) + arrays );
+    if( st==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        return NULL;
+    }
+    st->mem = mem;
+    st->numPoints = numPoints;
+    st->numNodes = 2*leaves - 1;
+    st->points = points;
+    st->low = (int*)(st + 1);
+    st->high = st->low + st->numNodes;
+    st->cnt = st->high + st->numNodes;
+    memset( st->cnt, 0, st->numNodes*sizeof(int) );
+
+    if( numPoints > 0 )
+        buildST( st, 0, 0, numPoints-1 );
+    return st;
+}
+
+/* buildST
+ * input: a SegmentTree, a node index, an int low, an int high
+ * output: none
+ *
+ * Recursively fills in node i and its descendants to cover the ranks from low to high
+ */
+void buildST( SegmentTree* st, int i, int low, int high ){
+    int mid = (high - low)/2 + low;
+    st->low[i] = low;
+    st->high[i] = high;
+    st->cnt[i] = 0;
+    if( low!=high ){
+        buildST( st, 2*i+1, low, mid );
+        buildST( st, 2*i+2, mid+1, high );
+    }
+}
+
+/* freeST
+ * input: a pointer to a SegmentTree
+ * output: none
+ *
+ * frees the given SegmentTree (but not its points)
+ */
+void freeST( SegmentTree* st ){
+    MemTracker mem = st->mem;
+    trackedFree( &mem, st, sizeof(SegmentTree) + 3*st->numNodes*sizeof(int) );
+}
+
+/* getSTMemStats
+ * input: a pointer to a SegmentTree, a pointer to store its MemStats in
+ * output: none
+ *
+ * Reports the memory held by the tree; the peak includes the private count arrays of a parallel insertSegmentsST
+ */
+void getSTMemStats( SegmentTree* st, MemStats* out ){
+    *out = st->mem.stats;
+}
+
+/* getRankST
+ * input: a SegmentTree, a double x
+ * output: an int
+ *
+ * Returns the rank of x among the tree's points, or -1 if x is not one of them
+ */
+int getRankST( SegmentTree* st, double x ){
+    int rank = lowerBoundPoint( st->points, st->numPoints, x );
+    if( rank==st->numPoints || st->points[rank]!=x )
+        return -1;
+    return rank;
+}
+
+/* getRankNearST
+ * input: a SegmentTree, a double x, and the rank of a point close to x
+ * output: an int
+ *
+ * Same as getRankST, but gallops outward from hint before binary searching, so looking up the ranks of
+ * nearby coordinates one after another (like consecutive positions of a route) costs O(log distance) each
+ */
+int getRankNearST( SegmentTree* st, double x, int hint ){
+    int low, high, step = 1, rank;
+
+    if( hint < 0 || hint >= st->numPoints )
+        return getRankST( st, x );
+    if( st->points[hint] < x ){
+        low = hint + 1;
+        while( hint + step < st->numPoints && st->points[hint + step] < x ){
+            low = hint + step + 1;
+            step *= 2;
+        }
+        high = hint + step < st->numPoints ? hint + step + 1 : st->numPoints;
+    }
+    else{
+        high = hint + 1;
+        while( hint - step >= 0 && st->points[hint - step] >= x ){
+            high = hint - step + 1;
+            step *= 2;
+        }
+        low = hint - step >= 0 ? hint - step : 0;
+    }
+    rank = low + lowerBoundPoint( st->points + low, high - low, x );
+    if( rank==st->numPoints || st->points[rank]!=x )
+        return -1;
+    return rank;
+}
+
+/* insertST and insertSTRec
+ * input: a SegmentTree, the rank of the segment's start and the rank of its end
+ * output: none
+ *
+ * Inserts the closed line segment between the two ranks into its canonical cover, like insertSegment
+ */
+void insertST( SegmentTree* st, int segmentStart, int segmentEnd ){
+    if( st->numPoints > 0 )
+        insertSTRec( st, st->cnt, 0, segmentStart, segmentEnd );
+}
+
+void insertSTRec( SegmentTree* st, int* cnt, int i, int segmentStart, int segmentEnd ){
+    COUNT( CNT_SEGMENT_VISITS );
+    if( segmentEnd < st->low[i] || segmentStart > st->high[i] )
+        return; /* segment does not overlap this node */
+    else if( segmentStart <= st->low[i] && st->high[i] <= segmentEnd ){
+        cnt[i]++;
+        return;
+    }
+    insertSTRec( st, cnt, 2*i+1, segmentStart, segmentEnd );
+    insertSTRec( st, cnt, 2*i+2, segmentStart, segmentEnd );
+}
+
+/* insertSegmentsST
+ * input: a SegmentTree, arrays holding the start and end rank of each segment, the number of segments, and a thread count
+ * output: none
+ *
+ * Inserts many segments at once.  The tree's shape never changes and insertion only increments counts, so each
+ * thread inserts its slice of the segments into a private count array indexed by node, with no locking at all.
+ * The private arrays are then summed into the tree, again split across the threads by node.
+ * Falls back to a serial insert if the private arrays cannot be allocated, and runs a slice on the calling thread if
+ * its thread cannot be created.
+ */
+void insertSegmentsST( SegmentTree* st, int* segmentStarts, int* segmentEnds, int numSegments, int numThreads ){
+    InsertSTArgs *args;
+    pthread_t *threads;
+    int t, i;
+
+    if( numThreads <= 1 || st->numPoints == 0 ){
+        for( i=0; i<numSegments; i++ )
+            insertST( st, segmentStarts[i], segmentEnds[i] );
+        return;
+    }
+
+    args = (InsertSTArgs*)trackedAlloc( &st->mem, numThreads*sizeof(InsertSTArgs) );
+    threads = (pthread_t*)trackedAlloc( &st->mem, numThreads*sizeof(pthread_t) );
+    if( args==NULL || threads==NULL ){
+        trackedFree( &st->mem, args, numThreads*sizeof(InsertSTArgs) );
+        trackedFree( &st->mem, threads, numThreads*sizeof(pthread_t) );
+        insertSegmentsST( st, segmentStarts, segmentEnds, numSegments, 1 );
+        return;
+    }
+    for( t=0; t<numThreads; t++ ){
+        args[t].st = st;
+        args[t].all = args;
+        args[t].numThreads = numThreads;
+        args[t].segmentStarts = segmentStarts;
+        args[t].segmentEnds = segmentEnds;
+        args[t].cnt = (int*)trackedAlloc( &st->mem, st->numNodes*sizeof(int) );
+        if( args[t].cnt==NULL ){
+            /* not enough memory for the private counts, so insert serially instead */
+            while( t-- > 0 )
+                trackedFree( &st->mem, args[t].cnt, st->numNodes*sizeof(int) );
+            trackedFree( &st->mem, args, numThreads*sizeof(InsertSTArgs) );
+            trackedFree( &st->mem, threads, numThreads*sizeof(pthread_t) );
+            insertSegmentsST( st, segmentStarts, segmentEnds, numSegments, 1 );
+            return;
+        }
+        memset( args[t].cnt, 0, st->numNodes*sizeof(int) );
+    }
+
+    for( t=0; t<numThreads; t++ ){
+        args[t].begin = (int)((long long)numSegments*t/numThreads);
+        args[t].end = (int)((long long)numSegments*(t+1)/numThreads);
+        args[t].running = pthread_create( &threads[t], NULL, insertSTWorker, &args[t] )==0;
+        if( !args[t].running )
+            insertSTWorker( &args[t] );
+    }
+    for( t=0; t<numThreads; t++ ){
+        if( args[t].running )
+            pthread_join( threads[t], NULL );
+    }
+
+    for( t=0; t<numThreads; t++ ){
+        args[t].begin = (int)((long long)st->numNodes*t/numThreads);
+        args[t].end = (int)((long long)st->numNodes*(t+1)/numThreads);
+        args[t].running = pthread_create( &threads[t], NULL, sumCountsSTWorker, &args[t] )==0;
+        if( !args[t].running )
+            sumCountsSTWorker( &args[t] );
+    }
+    for( t=0; t<numThreads; t++ ){
+        if( args[t].running )
+            pthread_join( threads[t], NULL );
+    }
+
+    for( t=0; t<numThreads; t++ )
+        trackedFree( &st->mem, args[t].cnt, st->numNodes*sizeof(int) );
+    trackedFree( &st->mem, threads, numThreads*sizeof(pthread_t) );
+    trackedFree( &st->mem, args, numThreads*sizeof(InsertSTArgs) );
+}
+
+/* insertSTWorker and sumCountsSTWorker
+ * input: a pointer to an InsertSTArgs
+ * output: NULL
+ *
+ * Inserts the segments from begin to end into the thread's private count array /
+ * adds every thread's private counts for the nodes from begin to end into the tree
+ */
+void *insertSTWorker( void *arg ){
+    InsertSTArgs *args = (InsertSTArgs*)arg;
+    int i;
+    for( i=args->begin; i<args->end; i++ )
+        insertSTRec( args->st, args->cnt, 0, args->segmentStarts[i], args->segmentEnds[i] );
+    FLUSH_COUNTERS( );
+    return NULL;
+}
+
+void *sumCountsSTWorker( void *arg ){
+    InsertSTArgs *args = (InsertSTArgs*)arg;
+    int i, t;
+    for( t=0; t<args->numThreads; t++ ){
+        int *cnt = args->all[t].cnt;
+        for( i=args->begin; i<args->end; i++ )
+            args->st->cnt[i] += cnt[i];
+    }
+    return NULL;
+}
+
+/* lineStabQueryST
+ * input: a SegmentTree, the rank of the query point
+ * output: the number of line segments which contain the query point
+ *
+ * Walks the root-to-leaf path containing the rank using index arithmetic, prefetching the next level
+ * while the current one is compared
+ */
+int lineStabQueryST( SegmentTree* st, int queryPoint ){
+    int i = 0, sum = 0;
+
+    if( queryPoint < 0 || queryPoint >= st->numPoints )
         return 0;
+    while( true ){
+        COUNT( CNT_SEGMENT_VISITS );
+        sum += st->cnt[i];
+        if( st->low[i] == st->high[i] ) /* bottom of the tree */
+            break;
+        if( 4*i+3 < st->numNodes ){ /* grandchildren exist, so the prefetch stays inside the arrays */
+            __builtin_prefetch( &st->high[4*i+3] );
+            __builtin_prefetch( &st->cnt[4*i+3] );
+        }
+        i = queryPoint <= st->high[2*i+1] ? 2*i+1 : 2*i+2;
+    }
+    return sum;
+}
+
+/* batchStabQueryST
+ * input: a SegmentTree and an optional int array with one entry per point
+ * output: the largest number of line segments containing any of the points
+ *
+ * Array-backed version of batchStabQuery: one traversal answers the query at every rank, storing the count
+ * for rank r in out[r] if out is not NULL
+ */
+int batchStabQueryST( SegmentTree* st, int* out ){
+    int max = 0;
+    if( st->numPoints > 0 )
+        batchStabQuerySTRec( st, 0, 0, out, &max );
+    return max;
+}
+
+void batchStabQuerySTRec( SegmentTree* st, int i, int acc, int* out, int* max ){
+    COUNT( CNT_SEGMENT_VISITS );
+    acc += st->cnt[i];
+    if( st->low[i] == st->high[i] ){ /* bottom of the tree */
+        if( out!=NULL )
+            out[ st->low[i] ] = acc;
+        if( acc>*max )
+            *max = acc;
+    }
+    else{
+        batchStabQuerySTRec( st, 2*i+1, acc, out, max );
+        batchStabQuerySTRec( st, 2*i+2, acc, out, max );
     }
-    else {
-        return lineStabQuery(root->pLeft, queryPoint) + lineStabQuery(root->pRight, queryPoint) + root->cnt;
+}
+
+
+
+/**********  Functions for dynamic Segment Tree **********/
+
+/* createDST and createDSTWithAllocator
+ * input: an array of sorted, unique doubles and its length (and the Allocator to take the tree's memory from, NULL
+ *        for malloc/free)
+ * output: a pointer to a DynamicSegmentTree (this is malloc-ed so must be freed eventually!)
+ *
+ * Builds an empty dynamic segment tree over the given points in a single allocation.
+ * Returns NULL if the tree cannot be allocated.
+ */
+DynamicSegmentTree* createDST( double* points, int numPoints ){
+    return createDSTWithAllocator( points, numPoints, NULL );
+}
+
+DynamicSegmentTree* createDSTWithAllocator( double* points, int numPoints, Allocator* allocator ){
+    DynamicSegmentTree* dst;
+    int leaves = 1, numNodes;
+    MemTracker mem;
+
+    while( leaves < numPoints )
+        leaves *= 2;
+    numNodes = 2*leaves - 1;
+
+    initMemTracker( &mem, allocator );
+    dst = (DynamicSegmentTree*)trackedAlloc( &mem, sizeof(DynamicSegmentTree) + numPoints*sizeof(double) + 2*numNodes*sizeof(int) );
+    if( dst==NULL ){
+        fprintf( stderr, "malloc failed\n" );
+        return NULL;
     }
-    // return -1;
+    dst->mem = mem;
+    dst->numPoints = numPoints;
+    dst->numNodes = numNodes;
+    dst->points = (double*)(dst + 1);
+    dst->add = (int*)(dst->points + numPoints);
+    dst->max = dst->add + numNodes;
+    memcpy( dst->points, points, numPoints*sizeof(double) );
+    memset( dst->add, 0, 2*numNodes*sizeof(int) );
+
+    return dst;
 }
 
+/* freeDST
+ * input: a pointer to a DynamicSegmentTree
+ * output: none
+ *
+ * frees the given DynamicSegmentTree
+ */
+void freeDST( DynamicSegmentTree* dst ){
+    MemTracker mem = dst->mem;
+    trackedFree( &mem, dst, sizeof(DynamicSegmentTree) + dst->numPoints*sizeof(double) + 2*dst->numNodes*sizeof(int) );
+}
+
+/* getDSTMemStats
+ * input: a pointer to a DynamicSegmentTree, a pointer to store its MemStats in
+ * output: none
+ *
+ * Reports the memory held by the tree
+ */
+void getDSTMemStats( DynamicSegmentTree* dst, MemStats* out ){
+    *out = dst->mem.stats;
+}
+
+/* insertDST and removeDST
+ * input: a DynamicSegmentTree, a double segmentStart, and a double segmentEnd
+ * output: none
+ *
+ * Adds / retires the closed segment from segmentStart to segmentEnd in O(log n).  The segment covers every point
+ * of the tree between its ends.  Only segments that were inserted may be removed.
+ */
+void insertDST( DynamicSegmentTree* dst, double segmentStart, double segmentEnd ){
+    updateDST( dst, segmentStart, segmentEnd, 1 );
+}
+
+void removeDST( DynamicSegmentTree* dst, double segmentStart, double segmentEnd ){
+    updateDST( dst, segmentStart, segmentEnd, -1 );
+}
+
+/* getMaxCoverageDST
+ * input: a DynamicSegmentTree
+ * output: an int
+ *
+ * Returns the largest number of stored segments that contain any single point, read from the root in O(1)
+ */
+int getMaxCoverageDST( DynamicSegmentTree* dst ){
+    return dst->numPoints > 0 ? dst->max[0] : 0;
+}
+
+/* updateDST and updateDSTRec
+ * input: a DynamicSegmentTree, the segment, and the change in coverage
+ * output: none
+ *
+ * Converts the segment to the range of point indices [first, last] it covers and adds delta to the canonical
+ * cover of that range.  On the way back up, max[i] = add[i] + the larger max of its children.
+ */
+void updateDST( DynamicSegmentTree* dst, double segmentStart, double segmentEnd, int delta ){
+    int first = lowerBoundPoint( dst->points, dst->numPoints, segmentStart );
+    int last = lowerBoundPoint( dst->points, dst->numPoints, segmentEnd );
+    if( last==dst->numPoints || dst->points[last]!=segmentEnd )
+        last--; /* segmentEnd is not a point, so the last covered point is the one before it */
+    if( first <= last )
+        updateDSTRec( dst, 0, 0, dst->numPoints-1, first, last, delta );
+}
+
+void updateDSTRec( DynamicSegmentTree* dst, int i, int low, int high, int first, int last, int delta ){
+    int mid = (high - low)/2 + low;
+    int childMax;
+
+    COUNT( CNT_SEGMENT_VISITS );
+    if( last < low || first > high )
+        return;
+    if( first <= low && high <= last ){
+        dst->add[i] += delta;
+        dst->max[i] += delta;
+        return;
+    }
+    updateDSTRec( dst, 2*i+1, low, mid, first, last, delta );
+    updateDSTRec( dst, 2*i+2, mid+1, high, first, last, delta );
+    childMax = dst->max[2*i+1] > dst->max[2*i+2] ? dst->max[2*i+1] : dst->max[2*i+2];
+    dst->max[i] = dst->add[i] + childMax;
+}
+
+/* lowerBoundPoint
+ * input: a sorted array of doubles, its length, and a double x
+ * output: an int
+ *
+ * Returns the index of the first point >= x (n if there is none)
+ */
+int lowerBoundPoint( double* points, int n, double x ){
+    int low = 0, high = n;
+    while( low < high ){
+        int mid = (high - low)/2 + low;
+        if( points[mid] < x )
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+
+/**********  Functions for freezing an AVL tree **********/
+
+/* freezeTree
+ * input: a pointer to an AVL Tree
+ * output: a boolean
+ *
+ * Moves the tree into one block in van Emde Boas order and returns TRUE.  The top half of the levels is laid out
+ * first (recursively in the same order), then each subtree hanging below it, so any path from the root crosses
+ * O(log_B n) cache lines or pages of size B without the layout knowing B.  The block holds the nodes (root first),
+ * one shared empty leaf whose pParent is NULL, and then each node's Data and key in the same order, since a search
+ * reads all three at every level.  searchTree, searchTreeBatch and the debugging functions work as before, but the
+ * tree can no longer be changed, Data pointers taken from it before freezing are no longer valid, and the Data is
+ * counted in the tree's MemStats from now on; freeTree frees the block.
+ * An empty tree is frozen too: its block holds only the shared leaf.
+ * Returns FALSE, leaving the tree as it was, if it is not an AVL tree, is already frozen, has a retireTNode callback
+ * (lock-free readers may still be walking its nodes, so they cannot be freed here), or the block or the temporary
+ * order (one pointer per node) cannot be allocated.  Both copies of the tree exist while it runs.
+ */
+bool freezeTree( Tree* t )
+{
+    int i, n, k = 0;
+    size_t keyBytes = 0, length, bytes;
+    TNode **order, *block, *sharedLeaf, *node;
+    Data *datas;
+    char *keys;
+
+    if( t->type!=AVL || t->frozenBytes > 0 || t->retireTNode!=NULL )
+        return false;
+    n = countTNodes( t->root );
+
+    order = NULL;
+    if( n > 0 ){
+        order = (TNode**)malloc( n*sizeof(TNode*) );
+        if( order==NULL )
+            return false;
+        layoutVEB( t->root, t->root->height, order, &k );
+    }
+    for( i=0; i<n; i++ )
+        keyBytes += strlen( order[i]->data->key ) + 1;
+
+    bytes = (n+1)*sizeof(TNode) + n*sizeof(Data) + keyBytes;
+    block = (TNode*)trackedAlloc( &t->mem, bytes );
+    if( block==NULL ){
+        free( order );
+        return false;
+    }
+    sharedLeaf = &block[n];
+    datas = (Data*)(sharedLeaf + 1);
+    keys = (char*)(datas + n);
+
+    /* cnt is unused in AVL trees, so it holds each node's new index while the links are moved over */
+    for( i=0; i<n; i++ )
+        order[i]->cnt = i;
+    for( i=0; i<n; i++ ){
+        node = &block[i];
+        *node = *order[i];
+        node->pLeft = order[i]->pLeft->leaf ? sharedLeaf : &block[ order[i]->pLeft->cnt ];
+        node->pRight = order[i]->pRight->leaf ? sharedLeaf : &block[ order[i]->pRight->cnt ];
+        node->pParent = order[i]->pParent==NULL ? NULL : &block[ order[i]->pParent->cnt ];
+        node->cnt = 0;
+        node->version = 0;
+
+        length = strlen( order[i]->data->key ) + 1;
+        datas[i] = *order[i]->data;
+        datas[i].key = memcpy( keys, order[i]->data->key, length );
+        keys += length;
+        node->data = &datas[i];
+        freeData( order[i]->data );
+    }
+    sharedLeaf->leaf = true;
+    sharedLeaf->height = 0;
+    sharedLeaf->version = 0;
+    sharedLeaf->data = NULL;
+    sharedLeaf->pParent = sharedLeaf->pLeft = sharedLeaf->pRight = NULL;
+
+    freeTNodes( t, t->root );
+    free( order );
+    t->root = block;
+    t->frozenBytes = bytes;
+    return true;
+}
+
+/* countTNodes
+ * input: the root of a tree
+ * output: an int
+ *
+ * Returns the number of non-leaf nodes in the tree
+ */
+int countTNodes( TNode* root )
+{
+    if( root->leaf )
+        return 0;
+    return 1 + countTNodes( root->pLeft ) + countTNodes( root->pRight );
+}
+
+/* layoutVEB and layoutVEBBottoms
+ * input: the root of a subtree, the number of its levels to lay out (and how deep below root the bottom subtrees
+ *        start), and the array to append the nodes to with its length so far
+ * output: none
+ *
+ * layoutVEB appends the top levels of root's subtree in van Emde Boas order: the top half of those levels first,
+ * then each subtree starting below them from left to right, all laid out the same way.  layoutVEBBottoms finds the
+ * subtrees depth levels below root.
+ */
+void layoutVEB( TNode* root, int levels, TNode** order, int* k )
+{
+    int top = levels/2;
+
+    if( root->leaf || levels == 0 )
+        return;
+    if( levels == 1 ){
+        order[(*k)++] = root;
+        return;
+    }
+    layoutVEB( root, top, order, k );
+    layoutVEBBottoms( root, top, levels - top, order, k );
+}
+
+void layoutVEBBottoms( TNode* root, int depth, int levels, TNode** order, int* k )
+{
+    if( root->leaf )
+        return;
+    if( depth == 0 ){
+        layoutVEB( root, levels, order, k );
+        return;
+    }
+    layoutVEBBottoms( root->pLeft, depth-1, levels, order, k );
+    layoutVEBBottoms( root->pRight, depth-1, levels, order, k );
+}
+
+/* freeTNodes
+ * input: a pointer to a Tree, the root of one of its subtrees
+ * output: none
+ *
+ * frees every node of the subtree but not its Data
+ */
+void freeTNodes( Tree* t, TNode* root )
+{
+    if( root==NULL )
+        return;
+    freeTNodes( t, root->pLeft );
+    freeTNodes( t, root->pRight );
+    freeTNode( t, root );
+}
 
 
 /**********  Functions for debugging an AVL tree **********/
@@ -513,9 +1427,10 @@ void checkAVLTree(TNode* root){
     if(root->leaf != true){
         if( getBalance(root)>1 ||  getBalance(root)<-1 )
             printf("ERROR - Node %s had balance %d\n",root->data->key,getBalance(root) );
-        if( root->pLeft!=NULL && root->pLeft->pParent!=root )
+        /* leaves are skipped since a frozen tree shares one leaf */
+        if( root->pLeft!=NULL && !root->pLeft->leaf && root->pLeft->pParent!=root )
             printf("ERROR - Invalid edge at %s-%s\n",root->data->key,root->pLeft->data->key );
-        if( root->pRight!=NULL && root->pRight->pParent!=root )
+        if( root->pRight!=NULL && !root->pRight->leaf && root->pRight->pParent!=root )
             printf("ERROR - Invalid edge at %s-%s\n",root->data->key,root->pRight->data->key );
 
         checkAVLTree(root->pLeft);
@@ -6,11 +6,17 @@
 #include <string.h>
 
 #include "data.h"
+#include "allocator.h"
 
 typedef struct Data Data;
 
 typedef enum treeType{ HUFFMAN, AVL, SEGMENT } treeType;
 
+/* Number of searches searchTreeBatch keeps in flight at once */
+#ifndef TREE_BATCH_GROUP
+#define TREE_BATCH_GROUP 16
+#endif
+
 typedef struct TNode
 {
     /* Data for every TNode */
@@ -22,6 +28,7 @@ typedef struct TNode
     /* AVL data */
     int height;             /* max number of nodes on path from this node down to a leaf of the tree */
     Data* data;             /* Pointer to the data stored in the node, leaves contain no valid data */
+    unsigned int version;   /* bumped before and after every change to leaf, data or the links, so it is odd mid-change */
 
     /* Huffman data */
     int priority;
@@ -32,39 +39,105 @@ typedef struct TNode
     int cnt;
 }  TNode;
 
+/* Pointer-free segment tree: node i has children 2i+1 and 2i+2, all arrays share one allocation.
+ * Nodes store ranks (indices into points) rather than coordinates. */
+typedef struct SegmentTree
+{
+    int numPoints;          /* number of sorted, unique points the tree was built over */
+    int numNodes;           /* length of the low, high and cnt arrays */
+    double *points;         /* side table mapping ranks back to coordinates (not owned by the tree) */
+    int *low, *high;        /* range of ranks [low, high] covered by each node */
+    int *cnt;               /* number of segments stored at each node */
+    MemTracker mem;         /* the tree's allocation and its scratch space while inserting */
+}  SegmentTree;
+
+/* Segment tree over a fixed set of points that also supports removing segments.  Node i has its children at
+ * 2i+1 and 2i+2; its coverage add[i] applies to its whole range and is never pushed down. */
+typedef struct DynamicSegmentTree
+{
+    int numPoints;          /* number of sorted, unique points the tree was built over */
+    int numNodes;           /* length of the add and max arrays */
+    double *points;         /* copy of the points */
+    int *add;               /* number of stored segments that cover each node's whole range */
+    int *max;               /* largest coverage of any point in each node's range (includes add) */
+    MemTracker mem;
+}  DynamicSegmentTree;
+
 typedef struct Tree
 {
     TNode* root;
     treeType type;
+
+    /* Called instead of free for nodes removed from an AVL tree (NULL to free them at once), so that nodes
+     * still seen by lock-free readers can be freed later */
+    void (*retireTNode)( void* arg, TNode* node );
+    void* retireArg;
+
+    MemTracker mem;         /* every node, Huffman str and the Tree itself are allocated through this */
+    size_t frozenBytes;     /* size of the block made by freezeTree (0 while the tree can change) */
 }  Tree;
 
 /**********  Functions for creating/freeing a tree **********/
 Tree *createTree( );
-Tree *createTreeFromTNode( TNode* root );
+Tree *createTreeWithAllocator( Allocator* allocator );
 void freeTree( Tree* t );
-void freeTreeContents( TNode *root, treeType type );
+void freeTreeContents( Tree* t, TNode *root );
+void getTreeMemStats( Tree* t, MemStats* out );
 
 /**********  Functions for creating/linking TNodes tree **********/
-void attachLeafNodes( TNode *ins );
+TNode* createTNode( Tree* t );
+void freeTNode( Tree* t, TNode* node );
+void attachLeafNodes( Tree* t, TNode *ins );
 void attachChildNodes( TNode* root, TNode* left, TNode* right );
 
 /**********  Functions for searching an AVL tree **********/
 TNode* searchTree( Tree *t, Data* tData );
 TNode* searchTreeRec( TNode *root, Data* tData );
+void searchTreeBatch( Tree *t, Data** keys, int n, TNode** out );
 
 /**********  Functions for inserting/removing from an AVL tree **********/
-void insertAtTNode( TNode *ins, Data* tData );
+void insertAtTNode( Tree* t, TNode *ins, Data* tData );
 void insertTree( Tree* t, Data* tData );
 void insertTreeBalanced( Tree* t, Data* tData );
 Data* removeTree( Tree* t, char* key );
 
+/**********  Functions for freezing an AVL tree **********/
+bool freezeTree( Tree* t );
+
+/**********  Functions for versioning TNodes **********/
+void beginWriteTNode( TNode* node );
+void endWriteTNode( TNode* node );
+
 /**********  Functions for getting Huffman Encoding **********/
 void printHuffmanEncoding( TNode* root, char c );
+int getHuffmanEncoding( TNode* root, char c, char* encoding );
 
 /**********  Functions for Segment Tree **********/
-TNode* constructSegmentTree( double* points, int low, int high);
+TNode* constructSegmentTree( Tree* t, double* points, int low, int high );
 void insertSegment( TNode* root, double segmentStart, double segmentEnd );
 int lineStabQuery( TNode* root, double queryPoint );
+int batchStabQuery( TNode* root, double* points, int n, int* out );
+
+/**********  Functions for array-backed Segment Tree **********/
+SegmentTree* createST( double* points, int numPoints );
+SegmentTree* createSTWithAllocator( double* points, int numPoints, Allocator* allocator );
+void freeST( SegmentTree* st );
+void getSTMemStats( SegmentTree* st, MemStats* out );
+int getRankST( SegmentTree* st, double x );
+int getRankNearST( SegmentTree* st, double x, int hint );
+void insertST( SegmentTree* st, int segmentStart, int segmentEnd );
+void insertSegmentsST( SegmentTree* st, int* segmentStarts, int* segmentEnds, int numSegments, int numThreads );
+int lineStabQueryST( SegmentTree* st, int queryPoint );
+int batchStabQueryST( SegmentTree* st, int* out );
+
+/**********  Functions for dynamic Segment Tree **********/
+DynamicSegmentTree* createDST( double* points, int numPoints );
+DynamicSegmentTree* createDSTWithAllocator( double* points, int numPoints, Allocator* allocator );
+void freeDST( DynamicSegmentTree* dst );
+void getDSTMemStats( DynamicSegmentTree* dst, MemStats* out );
+void insertDST( DynamicSegmentTree* dst, double segmentStart, double segmentEnd );
+void removeDST( DynamicSegmentTree* dst, double segmentStart, double segmentEnd );
+int getMaxCoverageDST( DynamicSegmentTree* dst );
 
 /**********  Functions for debugging an AVL tree **********/
 void printTree( TNode* root );